@@ -283,5 +283,125 @@ int main() {
       auto after = Clock::now();
       return after - before;
     });
+
+    // Same again, but through the virtual interface
+    measure("binary write with datapack (virtual)", N, [&]() {
+      dpack::BinaryWriter writer(data);
+      auto before = Clock::now();
+      static_cast<dpack::Writer&>(writer).value(input);
+      auto after = Clock::now();
+      return after - before;
+    });
+    measure("binary read with datapack (virtual)", N, [&]() {
+      dpack::BinaryReader reader(data);
+      auto before = Clock::now();
+      static_cast<dpack::Reader&>(reader).value(output);
+      auto after = Clock::now();
+      return after - before;
+    });
+  }
+
+  {
+    measure("to_binary with size pre-pass", N, [&]() {
+      auto before = Clock::now();
+      std::vector<std::uint8_t> data(dpack::binary_size(input));
+      dpack::to_binary(input, std::span<std::uint8_t>(data));
+      auto after = Clock::now();
+      return after - before;
+    });
+    measure("to_binary single pass", N, [&]() {
+      auto before = Clock::now();
+      std::vector<std::uint8_t> data = dpack::to_binary(input);
+      auto after = Clock::now();
+      return after - before;
+    });
+    std::vector<std::uint8_t> data;
+    measure("to_binary single pass, reused buffer", N, [&]() {
+      auto before = Clock::now();
+      dpack::to_binary(input, data);
+      auto after = Clock::now();
+      return after - before;
+    });
+  }
+
+  {
+    // Compact format: varint lengths, tags and integers
+    const auto format = dpack::BinaryFormat::Compact;
+    std::cout << "binary size fixed: " << dpack::binary_size(input) << std::endl;
+    std::cout << "binary size compact: " << dpack::binary_size(input, format) << std::endl;
+
+    std::vector<std::uint8_t> data;
+    std::vector<Entity> output(input.size());
+    measure("binary write compact", N, [&]() {
+      auto before = Clock::now();
+      dpack::to_binary(input, data, format);
+      auto after = Clock::now();
+      return after - before;
+    });
+    measure("binary read compact", N, [&]() {
+      dpack::BinaryReader reader(data, format);
+      auto before = Clock::now();
+      reader.value(output);
+      auto after = Clock::now();
+      return after - before;
+    });
+  }
+
+  {
+    // Aligned format: numbers padded to their natural alignment
+    const auto format = dpack::BinaryFormat::Aligned;
+    std::cout << "binary size aligned: " << dpack::binary_size(input, format) << std::endl;
+
+    std::vector<std::uint8_t> data;
+    std::vector<Entity> output(input.size());
+    measure("binary write aligned", N, [&]() {
+      auto before = Clock::now();
+      dpack::to_binary(input, data, format);
+      auto after = Clock::now();
+      return after - before;
+    });
+    measure("binary read aligned", N, [&]() {
+      dpack::BinaryReader reader(data, format);
+      auto before = Clock::now();
+      reader.value(output);
+      auto after = Clock::now();
+      return after - before;
+    });
+  }
+
+  {
+    // Large contiguous number arrays are copied in bulk by the binary packers
+    std::vector<double> points(1000000);
+    for (std::size_t i = 0; i < points.size(); i++) {
+      points[i] = 0.5 * i;
+    }
+    std::vector<std::uint8_t> data(dpack::binary_size(points));
+    std::vector<double> output;
+    measure("point cloud write", N, [&]() {
+      dpack::BinaryWriter writer(data);
+      auto before = Clock::now();
+      writer.value(points);
+      auto after = Clock::now();
+      return after - before;
+    });
+    measure("point cloud read", N, [&]() {
+      dpack::BinaryReader reader(data);
+      auto before = Clock::now();
+      reader.value(output);
+      auto after = Clock::now();
+      return after - before;
+    });
+    measure("point cloud write (per-element)", N, [&]() {
+      dpack::BinaryWriter writer(data);
+      auto before = Clock::now();
+      static_cast<dpack::Writer&>(writer).list_begin(points.size());
+      for (const double& point : points) {
+        writer.list_next();
+        writer.value(point);
+      }
+      writer.list_end();
+      auto after = Clock::now();
+      return after - before;
+    });
   }
 }
@@ -0,0 +1,72 @@
+#include <chrono>
+#include <datapack/examples/entity.hpp>
+#include <datapack/json.hpp>
+#include <datapack/random.hpp>
+#include <datapack/std/vector.hpp>
+#include <functional>
+#include <iostream>
+
+using Clock = std::chrono::high_resolution_clock;
+void measure(
+    const std::string& label,
+    std::size_t N,
+    std::size_t bytes,
+    const std::function<void()>& func) {
+  Clock::duration::rep nanos = 0;
+  for (std::size_t i = 0; i < N; i++) {
+    auto before = Clock::now();
+    func();
+    auto after = Clock::now();
+    nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+  }
+  nanos /= N;
+  double throughput = double(bytes) / nanos; // bytes/ns = GB/s
+  std::cout << label << ": " << nanos << " ns, " << throughput << " GB/s" << std::endl;
+}
+
+int main() {
+  std::size_t N = 10;
+  std::vector<Entity> input;
+  for (std::size_t n = 0; n < 2000; n++) {
+    input.push_back(dpack::random<Entity>());
+  }
+  for (auto& entity : input) {
+    entity.pose = {1.5, -2.25, 0.125};
+    if (entity.hitbox) {
+      entity.hitbox = Rect{4.0, 2.5};
+    }
+    entity.sprite.width = 8;
+    entity.sprite.height = 8;
+    entity.sprite.data.resize(8 * 8);
+  }
+
+  const std::string pretty = dpack::to_json(input);
+  const std::string compact = dpack::to_json(input, false);
+  std::cout << "pretty size: " << pretty.size() << std::endl;
+  std::cout << "compact size: " << compact.size() << std::endl;
+
+  measure("load_json pretty", N, pretty.size(), [&]() { dpack::load_json(pretty); });
+  measure("load_json compact", N, compact.size(), [&]() { dpack::load_json(compact); });
+  measure("from_json pretty", N, pretty.size(), [&]() {
+    dpack::from_json<std::vector<Entity>>(pretty);
+  });
+  measure("from_json compact", N, compact.size(), [&]() {
+    dpack::from_json<std::vector<Entity>>(compact);
+  });
+  measure("to_json pretty", N, pretty.size(), [&]() { dpack::to_json(input); });
+  measure("to_json compact", N, compact.size(), [&]() { dpack::to_json(input, false); });
+
+  const auto schema = dpack::Schema::make<std::vector<Entity>>();
+  const auto binary = dpack::to_binary(input);
+  measure("binary_to_json via object", N, compact.size(), [&]() {
+    dpack::Object object;
+    schema.apply(dpack::BinaryReader(binary), dpack::ObjectWriter(object));
+    dpack::dump_json(object);
+  });
+  measure("binary_to_json compact", N, compact.size(), [&]() {
+    dpack::binary_to_json(schema, binary, false);
+  });
+  measure("json_to_binary compact", N, compact.size(), [&]() {
+    dpack::json_to_binary(schema, compact);
+  });
+}
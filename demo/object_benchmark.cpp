@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <chrono>
+#include <datapack/object.hpp>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <stack>
+
+using Clock = std::chrono::high_resolution_clock;
+void measure(const std::string& label, std::size_t N, const std::function<void()>& func) {
+  Clock::duration::rep nanos = 0;
+  for (std::size_t i = 0; i < N; i++) {
+    auto before = Clock::now();
+    func();
+    auto after = Clock::now();
+    nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+  }
+  nanos /= N;
+  std::cout << label << ": " << nanos << " ns" << std::endl;
+}
+
+double iterate(dpack::ConstObject object) {
+  double sum = 0;
+  for (auto element : object["list"].values()) {
+    for (auto value : element.values()) {
+      if (auto number = value.number_if()) {
+        sum += *number;
+      } else if (auto string = value.string_if()) {
+        sum += string->size();
+      }
+    }
+  }
+  return sum;
+}
+
+// object_diff() without hashing, which compares every value in the trees
+dpack::Object walk_diff(dpack::ConstObject base_root, dpack::ConstObject modified_root) {
+  dpack::Object diff_root;
+  struct State {
+    dpack::ConstObject::Ptr base;
+    dpack::ConstObject::Ptr modified;
+    dpack::Object::Ptr diff;
+  };
+  std::stack<State> stack;
+  stack.push({base_root.ptr(), modified_root.ptr(), diff_root.ptr()});
+  while (!stack.empty()) {
+    auto [base, modified, diff] = stack.top();
+    stack.pop();
+    if (!base->is_map() || !modified->is_map()) {
+      if (*base != *modified) {
+        *diff = *modified;
+      }
+      continue;
+    }
+    diff->to_map();
+    for (auto [key, value] : modified->items()) {
+      if (auto base_ptr = base->find(key)) {
+        stack.push({base_ptr, value.ptr(), (*diff)[key].ptr()});
+      } else {
+        (*diff)[key] = value;
+      }
+    }
+  }
+  dpack::object_prune(diff_root);
+  return diff_root;
+}
+
+int main() {
+  const std::size_t N = 10;
+  const int size = 200000;
+
+  dpack::Object object;
+  auto list = object["list"];
+  for (int i = 0; i < size; i++) {
+    auto element = list.emplace_back();
+    element["index"] = i;
+    element["value"] = 0.5 * i;
+    element["name"] = "element_" + std::to_string(i);
+  }
+  measure("iterate (built in order)", N, [&]() { iterate(object); });
+
+  // Churn: erase a field from every element in a random order, then add it back in order,
+  // so the new nodes reuse free nodes scattered across the tree
+  std::vector<int> order(size);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), std::mt19937(0));
+  for (int i : order) {
+    list[i]["value"].erase();
+  }
+  for (int i = 0; i < size; i++) {
+    list[i]["value"] = 0.5 * i;
+  }
+  measure("iterate (after churn)", N, [&]() { iterate(object); });
+
+  measure("compact", 1, [&]() { object.compact(); });
+  measure("iterate (after compact)", N, [&]() { iterate(object); });
+
+  // Snapshots share storage with the original, so only the modified pages are copied
+  std::vector<dpack::Object> snapshots;
+  int next = 0;
+  measure("snapshot and modify", N, [&]() {
+    snapshots.push_back(object.clone());
+    object["list"][next++ * 1000]["value"] = -1.0;
+  });
+
+  // Diff of a large tree with a few changes, where hashing skips the unchanged subtrees
+  dpack::Object base;
+  for (int i = 0; i < size; i++) {
+    auto element = base["map"]["element_" + std::to_string(i)];
+    element["index"] = i;
+    element["value"] = 0.5 * i;
+    element["name"] = "element_" + std::to_string(i);
+  }
+  dpack::Object modified = base.clone();
+  for (int i = 0; i < size; i += size / 10) {
+    modified["map"]["element_" + std::to_string(i)]["value"] = -1.0;
+  }
+  measure("diff (compare every value)", N, [&]() { walk_diff(base, modified); });
+  measure("diff (hashed)", N, [&]() { dpack::object_diff(base, modified); });
+}
@@ -0,0 +1,52 @@
+#include <chrono>
+#include <datapack/object.hpp>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+using Clock = std::chrono::high_resolution_clock;
+void measure(const std::string& label, std::size_t N, const std::function<void()>& func) {
+  Clock::duration::rep nanos = 0;
+  for (std::size_t i = 0; i < N; i++) {
+    auto before = Clock::now();
+    func();
+    auto after = Clock::now();
+    nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+  }
+  nanos /= N;
+  std::cout << label << ": " << nanos << " ns" << std::endl;
+}
+
+int main() {
+  const std::size_t N = 3;
+
+  // Groups of uneven size, so that some subtrees are much larger than others
+  dpack::Object base;
+  for (int group = 0; group < 200; group++) {
+    auto map = base["group_" + std::to_string(group)];
+    int size = group % 10 == 0 ? 20000 : 1000;
+    for (int i = 0; i < size; i++) {
+      auto element = map["element_" + std::to_string(i)];
+      element["index"] = i;
+      element["value"] = 0.5 * i;
+      element["name"] = "element_" + std::to_string(i);
+    }
+  }
+  std::cout << "nodes: " << 5 * 200 * 1000 + 5 * 20 * 19000 << std::endl;
+
+  dpack::Object modified = base.clone();
+  for (int group = 0; group < 200; group += 7) {
+    modified["group_" + std::to_string(group)]["element_10"]["value"] = -1.0;
+  }
+  dpack::Object equal = base.clone();
+  equal["group_0"]["element_0"]["index"] = 0; // Unshare a page, so comparisons do the work
+  dpack::Object diff = dpack::object_diff(base, modified);
+
+  std::cout << "hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+  for (std::size_t threads : {1, 2, 4, 8, 16}) {
+    std::string suffix = " (" + std::to_string(threads) + " threads)";
+    measure("equal" + suffix, N, [&]() { dpack::object_equal(base, equal, threads); });
+    measure("diff" + suffix, N, [&]() { dpack::object_diff(base, modified, threads); });
+    measure("merge" + suffix, N, [&]() { dpack::object_merge(base, diff, threads); });
+  }
+}
@@ -0,0 +1,92 @@
+#include <chrono>
+#include <datapack/binary.hpp>
+#include <datapack/random.hpp>
+#include <datapack/schema/schema.hpp>
+#include <functional>
+#include <iostream>
+
+using Clock = std::chrono::high_resolution_clock;
+void measure(const std::string& label, std::size_t N, const std::function<void()>& func) {
+  Clock::duration::rep nanos = 0;
+  for (std::size_t i = 0; i < N; i++) {
+    auto before = Clock::now();
+    func();
+    auto after = Clock::now();
+    nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+  }
+  nanos /= N;
+  std::cout << label << ": " << nanos << " ns" << std::endl;
+}
+
+// Each level is an object with a number and an optional child
+void nested_tokens(std::vector<dpack::Token>& tokens, std::size_t depth) {
+  using namespace dpack;
+  tokens.push_back(token::ObjectBegin());
+  tokens.push_back(token::ObjectNext("x"));
+  tokens.push_back(token::Number::F64());
+  tokens.push_back(token::ObjectNext("child"));
+  tokens.push_back(token::Optional());
+  if (depth > 1) {
+    nested_tokens(tokens, depth - 1);
+  } else {
+    tokens.push_back(token::Number::F64());
+  }
+  tokens.push_back(token::ObjectEnd());
+}
+
+// Skip by scanning the tokens, for comparison
+dpack::Schema::Iterator skip_scan(dpack::Schema::Iterator iter) {
+  int depth = 0;
+  do {
+    while (iter.optional() || iter.list()) {
+      iter = iter.next();
+    }
+    if (iter.object_begin() || iter.tuple_begin() || iter.variant_begin()) {
+      depth++;
+    } else if (iter.object_end() || iter.tuple_end() || iter.variant_end()) {
+      depth--;
+    }
+    iter = iter.next();
+  } while (depth > 0);
+  return iter;
+}
+
+int main() {
+  std::size_t N = 10;
+  std::vector<dpack::Token> tokens;
+  nested_tokens(tokens, 1000);
+  const auto schema = dpack::Schema::from_tokens(tokens);
+  std::cout << "tokens: " << tokens.size() << std::endl;
+
+  measure("skip every token (table)", N, [&]() {
+    std::size_t total = 0;
+    for (auto iter = schema.begin(); iter != schema.end(); iter = iter.next()) {
+      total += iter.skip() == schema.end();
+    }
+    if (total == 0) {
+      std::cerr << "Unexpected result" << std::endl;
+    }
+  });
+  measure("skip every optional (scan)", N, [&]() {
+    std::size_t total = 0;
+    for (auto iter = schema.begin(); iter != schema.end(); iter = iter.next()) {
+      if (iter.optional()) {
+        total += skip_scan(iter) == schema.end();
+      }
+    }
+    if (total != 0) {
+      std::cerr << "Unexpected result" << std::endl;
+    }
+  });
+
+  std::vector<std::uint8_t> data;
+  dpack::RandomReader random_reader;
+  dpack::BinaryWriter writer(data);
+  schema.apply(random_reader, writer);
+  writer.finish();
+  measure("apply", N, [&]() {
+    dpack::BinaryReader reader(data);
+    dpack::BinarySizeWriter size_writer;
+    schema.apply(reader, size_writer);
+  });
+}
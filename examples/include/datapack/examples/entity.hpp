@@ -59,7 +59,7 @@ struct Entity {
   std::array<int, 3> assigned_items; // Tuple
 
   static Entity example();
-  DPACK_CLASS_DECL()
+  DPACK_CLASS_DECL_STATIC()
 };
 
 bool operator==(const Entity& a, const Entity& b);
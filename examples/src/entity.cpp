@@ -2,6 +2,7 @@
 
 #include <cmath>
 #include <cstring>
+#include <datapack/binary.hpp>
 #include <datapack/std/array.hpp>
 #include <datapack/std/optional.hpp>
 #include <datapack/std/string.hpp>
@@ -37,7 +38,7 @@ void Sprite::write(dpack::Writer& writer) const {
 }
 
 // clang-format off
-DPACK_CLASS_DEF(Entity,
+DPACK_CLASS_DEF_STATIC(Entity,
   index,
   name,
   enabled,
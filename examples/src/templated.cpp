@@ -1,4 +1,5 @@
 #include "datapack/examples/templated.hpp"
+#include <datapack/binary.hpp>
 
 namespace dpack {
 
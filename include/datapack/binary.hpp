@@ -1,14 +1,101 @@
 #pragma once
 
 #include "datapack/datapack.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <iosfwd>
 #include <stdexcept>
 #include <vector>
 
 namespace dpack {
 
-class BinarySizeWriter : public Writer {
+// The binary packers are static packers (see datapack.hpp). Fixed-size primitives and container
+// tags are implemented inline below so they can be inlined into the caller, while strings and
+// binary data are implemented in the source files.
+
+// Numbers are always stored little-endian, regardless of the host.
+// Fixed writes all numbers, lengths and tags with their native width.
+// Compact writes lengths, tags and integers as LEB128 varints, with signed integers zigzag
+// encoded, which is smaller when most values are small. Floats, u8 and booleans are unchanged.
+// Aligned is the same as Fixed, but pads each number to its natural alignment relative to the
+// start of the data, so numbers (and number arrays) in an aligned buffer can be accessed in place.
+// Data must be read with the same format it was written with.
+enum class BinaryFormat { Fixed, Compact, Aligned };
+
+constexpr bool native_little_endian = std::endian::native == std::endian::little;
+
+// Converts between native and little-endian byte order (the conversion is the same either way)
+template <typename T>
+T little_endian(T value) {
+  if constexpr (native_little_endian || sizeof(T) == 1) {
+    return value;
+  } else {
+    auto bytes = std::bit_cast<std::array<std::uint8_t, sizeof(T)>>(value);
+    std::reverse(bytes.begin(), bytes.end());
+    return std::bit_cast<T>(bytes);
+  }
+}
+
+// Number of padding bytes required to align the position, for a power of two alignment
+constexpr std::size_t align_padding(std::size_t pos, std::size_t alignment) {
+  return (alignment - pos % alignment) % alignment;
+}
+
+constexpr bool is_varint_number(NumberType type) {
+  return type == NumberType::I32 || type == NumberType::I64 || type == NumberType::U32
+      || type == NumberType::U64;
+}
+
+constexpr std::size_t varint_size(std::uint64_t value) {
+  std::size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+inline std::uint64_t zigzag_encode(std::int64_t value) {
+  return (std::uint64_t(value) << 1) ^ std::uint64_t(value >> 63);
+}
+
+inline std::int64_t zigzag_decode(std::uint64_t value) {
+  return std::int64_t(value >> 1) ^ -std::int64_t(value & 1);
+}
+
+// Integer value of a varint number type, zigzag encoded if signed
+inline std::uint64_t varint_value(NumberType type, const void* value) {
+  switch (type) {
+  case NumberType::I32:
+    return zigzag_encode(*(const std::int32_t*)value);
+  case NumberType::I64:
+    return zigzag_encode(*(const std::int64_t*)value);
+  case NumberType::U32:
+    return *(const std::uint32_t*)value;
+  case NumberType::U64:
+    return *(const std::uint64_t*)value;
+  default:
+    return 0;
+  }
+}
+
+class BinarySizeWriter final : public Writer {
 public:
-  BinarySizeWriter() : size_(0) {}
+  BinarySizeWriter(BinaryFormat format = BinaryFormat::Fixed) : format(format), size_(0) {}
+
+  template <writeable T>
+  void value(const T& value) {
+    write(*this, value);
+  }
+
+  template <writeable T>
+  void value(const char* key, const T& value) {
+    object_next(key);
+    write(*this, value);
+  }
 
   void number(NumberType type, const void* value) override;
   void boolean(bool value) override;
@@ -34,17 +121,69 @@ public:
   void tuple_next() override {}
   void tuple_end() override {}
 
+  void list_numbers(NumberType type, const void* data, std::size_t size) override;
+  void tuple_numbers(NumberType type, const void* data, std::size_t size) override;
+
   size_t size() const {
     return size_;
   }
 
 private:
+  void value_length(std::uint64_t length);
+  void value_tag(int value);
+  void align(std::size_t alignment);
+
+  BinaryFormat format;
   std::size_t size_;
 };
 
-class BinaryWriter : public Writer {
+class BinaryWriter final : public Writer {
 public:
-  BinaryWriter(std::span<std::uint8_t> buffer) : buffer(buffer), pos_(0) {}
+  // Writes into a fixed-size buffer, throwing if the buffer is too small
+  BinaryWriter(std::span<std::uint8_t> buffer, BinaryFormat format = BinaryFormat::Fixed) :
+      buffer(buffer), format(format), pos_(0), flushed(0) {}
+
+  // Writes into a vector from the start, growing it as required (amortised doubling).
+  // All of the existing capacity is used, so reusing the same vector across calls avoids
+  // reallocating. Call finish() once done to resize the vector to the written size.
+  template <typename Allocator>
+  BinaryWriter(
+      std::vector<std::uint8_t, Allocator>& vector,
+      BinaryFormat format = BinaryFormat::Fixed) :
+      resize_buffer([&vector](std::size_t size) {
+        vector.resize(size);
+        return std::span<std::uint8_t>(vector);
+      }),
+      format(format),
+      pos_(0),
+      flushed(0) {
+    buffer = resize_buffer(vector.capacity());
+  }
+
+  // Streams the output, using the given buffer to batch up writes to the sink. Large blocks of
+  // data (strings, binary data, number arrays) that don't fit are passed to the sink directly,
+  // so the buffer only needs to hold a single number. Call finish() once done to flush.
+  BinaryWriter(
+      const std::function<void(std::span<const std::uint8_t>)>& sink,
+      std::span<std::uint8_t> buffer,
+      BinaryFormat format = BinaryFormat::Fixed) :
+      buffer(buffer), flush_buffer(sink), format(format), pos_(0), flushed(0) {}
+
+  BinaryWriter(
+      std::ostream& os,
+      std::span<std::uint8_t> buffer,
+      BinaryFormat format = BinaryFormat::Fixed);
+
+  template <writeable T>
+  void value(const T& value) {
+    write(*this, value);
+  }
+
+  template <writeable T>
+  void value(const char* key, const T& value) {
+    object_next(key);
+    write(*this, value);
+  }
 
   void number(NumberType type, const void* value) override;
   void boolean(bool value) override;
@@ -70,22 +209,79 @@ public:
   void tuple_next() override {}
   void tuple_end() override {}
 
+  void list_numbers(NumberType type, const void* data, std::size_t size) override;
+  void tuple_numbers(NumberType type, const void* data, std::size_t size) override;
+
+  // Total number of bytes written, including any already flushed when streaming
   size_t pos() const {
-    return pos_;
+    return flushed + pos_;
   }
 
+  // If writing into a vector, resizes it to the number of bytes written.
+  // If streaming, flushes the remaining buffered data.
+  void finish();
+
 private:
   template <typename T>
   void value_number(T value);
   void value_bool(bool value);
+  void value_numbers(NumberType type, const void* data, std::size_t size);
+  void value_varint(std::uint64_t value);
+  void value_length(std::uint64_t length);
+  void value_tag(int value);
+  void value_bytes(const void* data, std::size_t size);
+  void value_bytes_slow(const void* data, std::size_t size);
+  void align(std::size_t alignment);
+
+  void reserve(std::size_t size) {
+    if (pos_ + size > buffer.size()) {
+      grow(size);
+    }
+  }
+  void grow(std::size_t size);
+  void flush();
 
   std::span<std::uint8_t> buffer;
+  std::function<std::span<std::uint8_t>(std::size_t)> resize_buffer;
+  std::function<void(std::span<const std::uint8_t>)> flush_buffer;
+  BinaryFormat format;
   std::size_t pos_;
+  std::size_t flushed;
 };
 
-class BinaryReader : public Reader {
+class BinaryReader final : public Reader {
 public:
-  BinaryReader(const std::span<const std::uint8_t>& buffer) : buffer(buffer), pos(0) {}
+  BinaryReader(
+      const std::span<const std::uint8_t>& buffer,
+      BinaryFormat format = BinaryFormat::Fixed) :
+      buffer(buffer), storage(nullptr), format(format), pos_(0), consumed(0) {}
+
+  // Streams the input, reading from the source into the given buffer as required. The source
+  // fills as much of the span as it can and returns the number of bytes read, or zero once
+  // there is no more data. The buffer grows if a single string or binary value doesn't fit.
+  // Strings and binary data are only valid until the next read, so borrowed views (eg:
+  // std::string_view) can't be used.
+  BinaryReader(
+      const std::function<std::size_t(std::span<std::uint8_t>)>& source,
+      std::vector<std::uint8_t>& buffer,
+      BinaryFormat format = BinaryFormat::Fixed) :
+      read_source(source), storage(&buffer), format(format), pos_(0), consumed(0) {}
+
+  BinaryReader(
+      std::istream& is,
+      std::vector<std::uint8_t>& buffer,
+      BinaryFormat format = BinaryFormat::Fixed);
+
+  template <readable T>
+  void value(T& value) {
+    read(*this, value);
+  }
+
+  template <readable T>
+  void value(const char* key, T& value) {
+    object_next(key);
+    read(*this, value);
+  }
 
   void number(NumberType type, void* value) override;
   bool boolean() override;
@@ -100,7 +296,9 @@ public:
   void variant_end() override {}
 
   void object_begin() override {}
-  void object_next(const char* key) override {}
+  bool object_next(const char* key) override {
+    return true;
+  }
   void object_end() override {}
 
   void tuple_begin() override {}
@@ -111,36 +309,511 @@ public:
   void list_next() override {}
   void list_end() override {}
 
+  void list_numbers(NumberType type, void* data, std::size_t size) override;
+  void tuple_numbers(NumberType type, void* data, std::size_t size) override;
+  const void* borrow_numbers(NumberType type, std::size_t size) override;
+  const char* borrow_string() override;
+  std::span<const std::uint8_t> borrow_binary() override;
+
+  // Total number of bytes read, including any before the buffer when streaming
+  std::size_t pos() const {
+    return consumed + pos_;
+  }
+
 private:
   template <typename T>
   void value_number(T& value);
   bool value_bool();
+  void value_numbers(NumberType type, void* data, std::size_t size);
+  std::uint64_t value_varint();
+  std::uint64_t value_length();
+  int value_tag();
+  void value_bytes(void* data, std::size_t size);
+  void value_bytes_slow(void* data, std::size_t size);
+  void align(std::size_t alignment);
+
+  bool available(std::size_t size) {
+    return pos_ + size <= buffer.size() || refill(size);
+  }
+  bool refill(std::size_t size);
 
   std::span<const std::uint8_t> buffer;
-  std::size_t pos;
+  std::function<std::size_t(std::span<std::uint8_t>)> read_source;
+  std::vector<std::uint8_t>* storage;
+  BinaryFormat format;
+  std::size_t pos_;
+  std::size_t consumed; // Bytes before the start of the buffer, if streaming
 };
 
+// ===================================
+// BinarySizeWriter
+
+inline void BinarySizeWriter::number(NumberType type, const void* value) {
+  if (format == BinaryFormat::Compact && is_varint_number(type)) {
+    size_ += varint_size(varint_value(type, value));
+    return;
+  }
+  align(number_size(type));
+  size_ += number_size(type);
+}
+
+inline void BinarySizeWriter::boolean(bool value) {
+  size_ += sizeof(value);
+}
+
+inline void BinarySizeWriter::enumerate(int value, const std::span<const char*>& labels) {
+  value_tag(value);
+}
+
+inline void BinarySizeWriter::optional_begin(bool has_value) {
+  size_ += sizeof(has_value);
+}
+
+inline void BinarySizeWriter::variant_begin(int value, const std::span<const char*>& labels) {
+  value_tag(value);
+}
+
+inline void BinarySizeWriter::list_begin(size_t size) {
+  value_length(size);
+}
+
+inline void BinarySizeWriter::list_numbers(NumberType type, const void* data, std::size_t size) {
+  tuple_numbers(type, data, size);
+}
+
+inline void BinarySizeWriter::tuple_numbers(NumberType type, const void* data, std::size_t size) {
+  if (format == BinaryFormat::Compact && is_varint_number(type)) {
+    for (std::size_t i = 0; i < size; i++) {
+      number(type, (const std::uint8_t*)data + i * number_size(type));
+    }
+    return;
+  }
+  align(number_size(type));
+  size_ += size * number_size(type);
+}
+
+inline void BinarySizeWriter::value_length(std::uint64_t length) {
+  if (format == BinaryFormat::Compact) {
+    size_ += varint_size(length);
+    return;
+  }
+  align(sizeof(length));
+  size_ += sizeof(length);
+}
+
+inline void BinarySizeWriter::value_tag(int value) {
+  if (format == BinaryFormat::Compact) {
+    size_ += varint_size(std::uint32_t(value));
+    return;
+  }
+  align(sizeof(value));
+  size_ += sizeof(value);
+}
+
+inline void BinarySizeWriter::align(std::size_t alignment) {
+  if (format == BinaryFormat::Aligned) {
+    size_ += align_padding(size_, alignment);
+  }
+}
+
+// ===================================
+// BinaryWriter
+
+inline void BinaryWriter::number(NumberType type, const void* value) {
+  if (format == BinaryFormat::Compact && is_varint_number(type)) {
+    value_varint(varint_value(type, value));
+    return;
+  }
+  switch (type) {
+  case NumberType::I32:
+    value_number(*(std::int32_t*)value);
+    break;
+  case NumberType::I64:
+    value_number(*(std::int64_t*)value);
+    break;
+  case NumberType::U32:
+    value_number(*(std::uint32_t*)value);
+    break;
+  case NumberType::U64:
+    value_number(*(std::uint64_t*)value);
+    break;
+  case NumberType::U8:
+    value_number(*(std::uint8_t*)value);
+    break;
+  case NumberType::F32:
+    value_number(*(float*)value);
+    break;
+  case NumberType::F64:
+    value_number(*(double*)value);
+    break;
+  }
+}
+
+inline void BinaryWriter::boolean(bool value) {
+  value_bool(value);
+}
+
+inline void BinaryWriter::enumerate(int value, const std::span<const char*>& labels) {
+  value_tag(value);
+}
+
+inline void BinaryWriter::optional_begin(bool has_value) {
+  value_bool(has_value);
+}
+
+inline void BinaryWriter::variant_begin(int value, const std::span<const char*>& labels) {
+  value_tag(value);
+}
+
+inline void BinaryWriter::list_begin(size_t size) {
+  value_length(size);
+}
+
+inline void BinaryWriter::list_numbers(NumberType type, const void* data, std::size_t size) {
+  value_numbers(type, data, size);
+}
+
+inline void BinaryWriter::tuple_numbers(NumberType type, const void* data, std::size_t size) {
+  value_numbers(type, data, size);
+}
+
+template <typename T>
+void BinaryWriter::value_number(T value) {
+  align(sizeof(T));
+  reserve(sizeof(T));
+  value = little_endian(value);
+  std::memcpy(&buffer[pos_], &value, sizeof(T));
+  pos_ += sizeof(T);
+}
+
+inline void BinaryWriter::value_bool(bool value) {
+  reserve(1);
+  buffer[pos_] = (value ? 0x01 : 0x00);
+  pos_++;
+}
+
+inline void BinaryWriter::value_numbers(NumberType type, const void* data, std::size_t size) {
+  if (format == BinaryFormat::Compact && is_varint_number(type)) {
+    for (std::size_t i = 0; i < size; i++) {
+      value_varint(varint_value(type, (const std::uint8_t*)data + i * number_size(type)));
+    }
+    return;
+  }
+  if (!native_little_endian && number_size(type) > 1) {
+    for (std::size_t i = 0; i < size; i++) {
+      number(type, (const std::uint8_t*)data + i * number_size(type));
+    }
+    return;
+  }
+  align(number_size(type));
+  value_bytes(data, size * number_size(type));
+}
+
+inline void BinaryWriter::value_bytes(const void* data, std::size_t size) {
+  if (pos_ + size > buffer.size()) {
+    value_bytes_slow(data, size);
+    return;
+  }
+  std::memcpy(&buffer[pos_], data, size);
+  pos_ += size;
+}
+
+inline void BinaryWriter::align(std::size_t alignment) {
+  if (format == BinaryFormat::Aligned) {
+    std::size_t padding = align_padding(pos(), alignment);
+    reserve(padding);
+    std::memset(&buffer[pos_], 0, padding);
+    pos_ += padding;
+  }
+}
+
+inline void BinaryWriter::value_varint(std::uint64_t value) {
+  reserve(10); // Maximum size of a 64-bit varint
+  while (value >= 0x80) {
+    buffer[pos_++] = std::uint8_t(value) | 0x80;
+    value >>= 7;
+  }
+  buffer[pos_++] = std::uint8_t(value);
+}
+
+inline void BinaryWriter::value_length(std::uint64_t length) {
+  if (format == BinaryFormat::Compact) {
+    value_varint(length);
+  } else {
+    value_number(length);
+  }
+}
+
+inline void BinaryWriter::value_tag(int value) {
+  if (format == BinaryFormat::Compact) {
+    value_varint(std::uint32_t(value));
+  } else {
+    value_number(value);
+  }
+}
+
+// ===================================
+// BinaryReader
+
+inline void BinaryReader::number(NumberType type, void* value) {
+  if (format == BinaryFormat::Compact && is_varint_number(type)) {
+    std::uint64_t varint = value_varint();
+    switch (type) {
+    case NumberType::I32:
+      *(std::int32_t*)value = zigzag_decode(varint);
+      break;
+    case NumberType::I64:
+      *(std::int64_t*)value = zigzag_decode(varint);
+      break;
+    case NumberType::U32:
+      *(std::uint32_t*)value = varint;
+      break;
+    case NumberType::U64:
+      *(std::uint64_t*)value = varint;
+      break;
+    default:
+      break;
+    }
+    return;
+  }
+  switch (type) {
+  case NumberType::I32:
+    value_number(*(std::int32_t*)value);
+    break;
+  case NumberType::I64:
+    value_number(*(std::int64_t*)value);
+    break;
+  case NumberType::U32:
+    value_number(*(std::uint32_t*)value);
+    break;
+  case NumberType::U64:
+    value_number(*(std::uint64_t*)value);
+    break;
+  case NumberType::U8:
+    value_number(*(std::uint8_t*)value);
+    break;
+  case NumberType::F32:
+    value_number(*(float*)value);
+    break;
+  case NumberType::F64:
+    value_number(*(double*)value);
+    break;
+  }
+}
+
+inline bool BinaryReader::boolean() {
+  return value_bool();
+}
+
+inline int BinaryReader::enumerate(const std::span<const char*>& labels) {
+  return value_tag();
+}
+
+inline bool BinaryReader::optional_begin() {
+  return value_bool();
+}
+
+inline int BinaryReader::variant_begin(const std::span<const char*>& labels) {
+  return value_tag();
+}
+
+inline size_t BinaryReader::list_begin() {
+  return value_length();
+}
+
+inline void BinaryReader::list_numbers(NumberType type, void* data, std::size_t size) {
+  value_numbers(type, data, size);
+}
+
+inline void BinaryReader::tuple_numbers(NumberType type, void* data, std::size_t size) {
+  value_numbers(type, data, size);
+}
+
+inline const void* BinaryReader::borrow_numbers(NumberType type, std::size_t size) {
+  // Streamed data is only valid until the next refill
+  if (storage || (format == BinaryFormat::Compact && is_varint_number(type))) {
+    return nullptr;
+  }
+  if (!native_little_endian && number_size(type) > 1) {
+    return nullptr;
+  }
+  align(number_size(type));
+  const std::size_t bytes = size * number_size(type);
+  if (pos_ + bytes > buffer.size()) {
+    invalidate();
+    return nullptr;
+  }
+  const std::uint8_t* result = buffer.data() + pos_;
+  // Can't borrow numbers that aren't aligned within the buffer
+  if (reinterpret_cast<std::uintptr_t>(result) % number_size(type) != 0) {
+    return nullptr;
+  }
+  pos_ += bytes;
+  return result;
+}
+
+inline const char* BinaryReader::borrow_string() {
+  // Streamed data is only valid until the next refill
+  if (storage) {
+    invalidate();
+    return nullptr;
+  }
+  return string();
+}
+
+inline std::span<const std::uint8_t> BinaryReader::borrow_binary() {
+  if (storage) {
+    invalidate();
+    return {};
+  }
+  return binary();
+}
+
+template <typename T>
+void BinaryReader::value_number(T& value) {
+  align(sizeof(T));
+  if (!available(sizeof(T))) {
+    invalidate();
+    return;
+  }
+
+  std::memcpy(&value, &buffer[pos_], sizeof(T));
+  value = little_endian(value);
+  pos_ += sizeof(T);
+}
+
+inline bool BinaryReader::value_bool() {
+  if (!available(1)) {
+    invalidate();
+    return false;
+  }
+  std::uint8_t value_int = buffer[pos_];
+  if (value_int >= 2) {
+    invalidate();
+    return false;
+  }
+  pos_++;
+  return value_int;
+}
+
+inline void BinaryReader::value_numbers(NumberType type, void* data, std::size_t size) {
+  if (format == BinaryFormat::Compact && is_varint_number(type)) {
+    for (std::size_t i = 0; i < size; i++) {
+      number(type, (std::uint8_t*)data + i * number_size(type));
+    }
+    return;
+  }
+  if (!native_little_endian && number_size(type) > 1) {
+    for (std::size_t i = 0; i < size; i++) {
+      number(type, (std::uint8_t*)data + i * number_size(type));
+    }
+    return;
+  }
+  align(number_size(type));
+  value_bytes(data, size * number_size(type));
+}
+
+inline void BinaryReader::value_bytes(void* data, std::size_t size) {
+  if (pos_ + size > buffer.size()) {
+    value_bytes_slow(data, size);
+    return;
+  }
+  std::memcpy(data, &buffer[pos_], size);
+  pos_ += size;
+}
+
+inline void BinaryReader::align(std::size_t alignment) {
+  if (format == BinaryFormat::Aligned) {
+    std::size_t padding = align_padding(consumed + pos_, alignment);
+    if (!available(padding)) {
+      invalidate();
+      return;
+    }
+    pos_ += padding;
+  }
+}
+
+inline std::uint64_t BinaryReader::value_varint() {
+  std::uint64_t value = 0;
+  for (std::size_t shift = 0; shift < 64; shift += 7) {
+    if (!available(1)) {
+      break;
+    }
+    std::uint8_t byte = buffer[pos_++];
+    value |= std::uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+  invalidate();
+  return 0;
+}
+
+inline std::uint64_t BinaryReader::value_length() {
+  if (format == BinaryFormat::Compact) {
+    return value_varint();
+  }
+  std::uint64_t length = 0;
+  value_number(length);
+  return length;
+}
+
+inline int BinaryReader::value_tag() {
+  if (format == BinaryFormat::Compact) {
+    return int(std::uint32_t(value_varint()));
+  }
+  int value = -1;
+  value_number(value);
+  return value;
+}
+
+// ===================================
+// Helpers
+
 template <writeable T>
-size_t binary_size(const T& value) {
-  BinarySizeWriter size_writer;
+size_t binary_size(const T& value, BinaryFormat format = BinaryFormat::Fixed) {
+  if constexpr (fixed_size_type<T>) {
+    if (format == BinaryFormat::Fixed) {
+      return fixed_binary_size<T>;
+    }
+  }
+  BinarySizeWriter size_writer(format);
   size_writer.value(value);
   return size_writer.size();
 }
 
-template <writeable T>
-std::vector<std::uint8_t> to_binary(const T& value) {
-  std::vector<std::uint8_t> buffer(binary_size(value));
-  BinaryWriter writer(buffer);
-  writer.value(value);
-  if (writer.pos() != buffer.size()) {
-    throw std::runtime_error("Write size did not match buffer size");
+template <writeable T, typename Allocator>
+void to_binary(
+    const T& value,
+    std::vector<std::uint8_t, Allocator>& buffer,
+    BinaryFormat format = BinaryFormat::Fixed) {
+  if constexpr (fixed_size_type<T>) {
+    if (format == BinaryFormat::Fixed) {
+      // Size the vector once, instead of growing it as the value is written
+      buffer.resize(fixed_binary_size<T>);
+      BinaryWriter writer(std::span<std::uint8_t>(buffer), format);
+      writer.value(value);
+      return;
+    }
   }
+  BinaryWriter writer(buffer, format);
+  writer.value(value);
+  writer.finish();
+}
+
+template <writeable T>
+std::vector<std::uint8_t> to_binary(const T& value, BinaryFormat format = BinaryFormat::Fixed) {
+  std::vector<std::uint8_t> buffer;
+  to_binary(value, buffer, format);
   return buffer;
 }
 
 template <writeable T>
-void to_binary(const T& value, const std::span<std::uint8_t>& buffer) {
-  BinaryWriter writer(buffer);
+void to_binary(
+    const T& value,
+    const std::span<std::uint8_t>& buffer,
+    BinaryFormat format = BinaryFormat::Fixed) {
+  BinaryWriter writer(buffer, format);
   writer.value(value);
   if (writer.pos() != buffer.size()) {
     throw std::runtime_error("Write size did not match buffer size");
@@ -148,9 +821,11 @@ void to_binary(const T& value, const std::span<std::uint8_t>& buffer) {
 }
 
 template <readable T>
-T from_binary(const std::span<const std::uint8_t>& buffer) {
+T from_binary(
+    const std::span<const std::uint8_t>& buffer,
+    BinaryFormat format = BinaryFormat::Fixed) {
   T result;
-  BinaryReader(buffer).value(result);
+  BinaryReader(buffer, format).value(result);
   return result;
 }
 
@@ -4,14 +4,66 @@
 #include "datapack/labelled_enum.hpp"
 #include <concepts>
 #include <cstdint>
+#include <initializer_list>
 #include <span>
 #include <string>
+#include <type_traits>
 
 namespace dpack {
 
 enum class NumberType { I32, I64, U32, U64, U8, F32, F64 };
 
+constexpr std::size_t number_size(NumberType type) {
+  switch (type) {
+  case NumberType::I32:
+  case NumberType::U32:
+  case NumberType::F32:
+    return 4;
+  case NumberType::I64:
+  case NumberType::U64:
+  case NumberType::F64:
+    return 8;
+  case NumberType::U8:
+    return 1;
+  }
+  return 0;
+}
+
+// Maps arithmetic types to their NumberType, see DPACK_NUMBER below
+template <typename T>
+struct number_details {};
+
+template <typename T>
+concept numeric = requires() {
+  { number_details<T>::type } -> std::convertible_to<NumberType>;
+};
+
+template <numeric T>
+constexpr NumberType number_type = number_details<T>::type;
+
 class Writer;
+class Reader;
+
+template <typename T>
+concept writer_type = std::derived_from<T, Writer>;
+
+template <typename T>
+concept reader_type = std::derived_from<T, Reader>;
+
+// Static packers are final and implemented in headers, so when their concrete type is known
+// the compiler can inline the whole traversal instead of making a virtual call per primitive.
+// Out-of-line definitions (DPACK_DEF, DPACK_CLASS_DEF_STATIC, ...) are explicitly instantiated
+// for these, so datapack/binary.hpp must be included where they are used, and use the virtual
+// interface for any other packer.
+class BinarySizeWriter;
+class BinaryWriter;
+class BinaryReader;
+
+template <typename T>
+concept static_writer = std::same_as<T, BinaryWriter> || std::same_as<T, BinarySizeWriter>;
+
+template <typename T>
+concept static_reader = std::same_as<T, BinaryReader>;
 
 template <typename T>
 concept writeable = requires(Writer& writer, const T& value) {
@@ -22,13 +74,16 @@ template <typename T>
 concept writeable_method = requires(const T& value, Writer& writer) {
   { value.write(writer) };
 };
-template <writeable_method T>
-inline void write(Writer& writer, const T& value) {
-  value.write(writer);
+// Classes declared with DPACK_CLASS_DECL() only have the virtual method
+template <writeable_method T, writer_type Packer>
+inline void write(Packer& writer, const T& value) {
+  if constexpr (requires { value.template write<Packer>(writer); }) {
+    value.template write<Packer>(writer);
+  } else {
+    value.write(static_cast<Writer&>(writer));
+  }
 }
 
-class Reader;
-
 template <typename T>
 concept readable = requires(Reader& reader, T& value) {
   { read(reader, value) };
@@ -38,9 +93,13 @@ template <typename T>
 concept readable_method = requires(Reader& reader, T& value) {
   { value.read(reader) };
 };
-template <readable_method T>
-inline void read(Reader& reader, T& value) {
-  value.read(reader);
+template <readable_method T, reader_type Packer>
+inline void read(Packer& reader, T& value) {
+  if constexpr (requires { value.template read<Packer>(reader); }) {
+    value.template read<Packer>(reader);
+  } else {
+    value.read(static_cast<Reader&>(reader));
+  }
 }
 
 template <typename T>
@@ -96,6 +155,24 @@ public:
   virtual void list_next() = 0;
   virtual void list_end() = 0;
 
+  // Contiguous numbers within a list or tuple, called between *_begin() and *_end()
+  // in place of the per-element calls. By default these write each element individually,
+  // but packers can override them to handle the data in bulk.
+
+  virtual void list_numbers(NumberType type, const void* data, std::size_t size) {
+    for (std::size_t i = 0; i < size; i++) {
+      list_next();
+      number(type, (const std::uint8_t*)data + i * number_size(type));
+    }
+  }
+
+  virtual void tuple_numbers(NumberType type, const void* data, std::size_t size) {
+    for (std::size_t i = 0; i < size; i++) {
+      tuple_next();
+      number(type, (const std::uint8_t*)data + i * number_size(type));
+    }
+  }
+
   // Other
 
   virtual void hint(const Hint& hint) {}
@@ -112,10 +189,12 @@ public:
     read(*this, value);
   }
 
+  // Members that aren't in the data aren't read, so keep their current value
   template <readable T>
   void value(const char* key, T& value) {
-    object_next(key);
-    read(*this, value);
+    if (object_next(key)) {
+      read(*this, value);
+    }
   }
 
   // Primitives
@@ -138,7 +217,9 @@ public:
   // Fixed-size containers
 
   virtual void object_begin() = 0;
-  virtual void object_next(const char* key) = 0;
+  // Returns false if the member isn't in the data, in which case its value shouldn't be read
+  // (eg: SchemaEvolutionReader, for members added since the data was written)
+  virtual bool object_next(const char* key) = 0;
   virtual void object_end() = 0;
 
   virtual void tuple_begin() = 0;
@@ -151,6 +232,38 @@ public:
   virtual void list_next() = 0;
   virtual void list_end() = 0;
 
+  // See Writer::list_numbers() and Writer::tuple_numbers()
+
+  virtual void list_numbers(NumberType type, void* data, std::size_t size) {
+    for (std::size_t i = 0; i < size; i++) {
+      list_next();
+      number(type, (std::uint8_t*)data + i * number_size(type));
+    }
+  }
+
+  virtual void tuple_numbers(NumberType type, void* data, std::size_t size) {
+    for (std::size_t i = 0; i < size; i++) {
+      tuple_next();
+      number(type, (std::uint8_t*)data + i * number_size(type));
+    }
+  }
+
+  // Alternative to list_numbers() which returns a pointer to the numbers within the underlying
+  // buffer instead of copying them, or nullptr if the reader cannot do this. The data remains
+  // owned by the source being read from.
+  virtual const void* borrow_numbers(NumberType type, std::size_t size) {
+    return nullptr;
+  }
+
+  // Same as string() and binary(), but the result is kept after reading other values (eg: by
+  // std::string_view), so readers whose buffer is reused within a value invalidate instead
+  virtual const char* borrow_string() {
+    return string();
+  }
+  virtual std::span<const std::uint8_t> borrow_binary() {
+    return binary();
+  }
+
   // Other
 
   void invalidate() {
@@ -172,10 +285,16 @@ private:
 };
 
 #define DPACK_NUMBER(Type, Enum)                                                                   \
-  inline void write(Writer& writer, const Type& value) {                                           \
+  template <>                                                                                      \
+  struct number_details<Type> {                                                                    \
+    static constexpr NumberType type = NumberType::Enum;                                           \
+  };                                                                                               \
+  template <writer_type Packer>                                                                    \
+  void write(Packer& writer, const Type& value) {                                                  \
     writer.number(NumberType::Enum, &value);                                                       \
   }                                                                                                \
-  inline void read(Reader& reader, Type& value) {                                                  \
+  template <reader_type Packer>                                                                    \
+  void read(Packer& reader, Type& value) {                                                         \
     reader.number(NumberType::Enum, &value);                                                       \
   }
 
@@ -189,23 +308,76 @@ DPACK_NUMBER(double, F64);
 
 #undef DPACK_NUMBER
 
-inline void write(Writer& writer, const bool& value) {
+template <writer_type Packer>
+void write(Packer& writer, const bool& value) {
   writer.boolean(value);
 }
-inline void read(Reader& reader, bool& value) {
+template <reader_type Packer>
+void read(Packer& reader, bool& value) {
   value = reader.boolean();
 }
 
-template <labelled_enum T>
-void write(Writer& writer, const T& value) {
+template <labelled_enum T, writer_type Packer>
+void write(Packer& writer, const T& value) {
   writer.enumerate((int)value, enum_labels<T>);
 }
 
-template <labelled_enum T>
-void read(Reader& reader, T& value) {
+template <labelled_enum T, reader_type Packer>
+void read(Packer& reader, T& value) {
   value = (T)reader.enumerate(enum_labels<T>);
 }
 
+// Fixed-size types
+// Some types always have the same binary size in the Fixed format, known at compile time:
+// numbers, booleans, enums, std::array of fixed-size types, and objects declared with
+// DPACK_INLINE() or DPACK_CLASS_INLINE() whose members are all fixed-size. Other types can opt in
+// by defining fixed_size(Query, const T*), or a static T::fixed_size<Query>(), which return
+// Query::object(...) of their member sizes (see the macros below).
+
+struct FixedSizeQuery {
+  static constexpr std::size_t variable = std::size_t(-1);
+
+  template <typename T>
+  static constexpr std::size_t size() {
+    using U = std::remove_cvref_t<T>;
+    if constexpr (numeric<U>) {
+      return number_size(number_type<U>);
+    } else if constexpr (std::same_as<U, bool>) {
+      return 1;
+    } else if constexpr (labelled_enum<U>) {
+      return sizeof(int);
+    } else if constexpr (requires { U::template fixed_size<FixedSizeQuery>(); }) {
+      return U::template fixed_size<FixedSizeQuery>();
+    } else if constexpr (requires { fixed_size(FixedSizeQuery(), (const U*)nullptr); }) {
+      return fixed_size(FixedSizeQuery(), (const U*)nullptr);
+    } else {
+      return variable;
+    }
+  }
+
+  template <std::same_as<std::size_t>... Sizes>
+  static constexpr std::size_t object(Sizes... sizes) {
+    std::size_t total = 0;
+    for (std::size_t size : {std::size_t(0), sizes...}) {
+      if (size == variable) {
+        return variable;
+      }
+      total += size;
+    }
+    return total;
+  }
+
+  static constexpr std::size_t array(std::size_t size, std::size_t count) {
+    return size == variable ? variable : size * count;
+  }
+};
+
+template <typename T>
+concept fixed_size_type = FixedSizeQuery::size<T>() != FixedSizeQuery::variable;
+
+template <fixed_size_type T>
+constexpr std::size_t fixed_binary_size = FixedSizeQuery::size<T>();
+
 // Nasty macro magic!
 // Hopefully this can be replaced by C++ reflection at some point
 // https://stackoverflow.com/a/11994395
@@ -245,6 +417,8 @@ void read(Reader& reader, T& value) {
 
 #define _DPACK_VALUE(X) packer.value(#X, value.X);
 #define _DPACK_CLASS_VALUE(X) packer.value(#X, X);
+#define _DPACK_SIZE(X) , Query::template size<decltype(Value::X)>()
+#define _DPACK_CLASS_SIZE(X) , Query::template size<decltype(X)>()
 
 // https://stackoverflow.com/a/62984543
 // Needs to support both:
@@ -259,21 +433,45 @@ void read(Reader& reader, T& value) {
 // ===================================================================================
 // Free function macros
 
+#define _DPACK_OBJECT_BODY(...)                                                                    \
+  packer.object_begin();                                                                           \
+  _DPACK_FOR_EACH(_DPACK_VALUE, __VA_ARGS__)                                                       \
+  packer.object_end();
+
+#define _DPACK_CLASS_OBJECT_BODY(...)                                                              \
+  packer.object_begin();                                                                           \
+  _DPACK_FOR_EACH(_DPACK_CLASS_VALUE, __VA_ARGS__)                                                 \
+  packer.object_end();
+
+#define _DPACK_INSTANTIATE_STATIC(Type)                                                            \
+  template void read<BinaryReader>(BinaryReader & packer, Type & value);                           \
+  template void write<BinaryWriter>(BinaryWriter & packer, const Type& value);                     \
+  template void write<BinarySizeWriter>(BinarySizeWriter & packer, const Type& value);
+
 #define DPACK_DECL(Type)                                                                           \
   void read(Reader& packer, Type& value);                                                          \
-  void write(Writer& packer, const Type& value);
+  void write(Writer& packer, const Type& value);                                                   \
+  template <static_reader Packer>                                                                  \
+  void read(Packer& packer, Type& value);                                                          \
+  template <static_writer Packer>                                                                  \
+  void write(Packer& packer, const Type& value);
 
 #define DPACK_DEF(Type, ...)                                                                       \
   void read(Reader& packer, Type& value) {                                                         \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_VALUE, __VA_ARGS__)                                                     \
-    packer.object_end();                                                                           \
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
   }                                                                                                \
   void write(Writer& packer, const Type& value) {                                                  \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_VALUE, __VA_ARGS__)                                                     \
-    packer.object_end();                                                                           \
-  }
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
+  }                                                                                                \
+  template <static_reader Packer>                                                                  \
+  void read(Packer& packer, Type& value) {                                                         \
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
+  }                                                                                                \
+  template <static_writer Packer>                                                                  \
+  void write(Packer& packer, const Type& value) {                                                  \
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
+  }                                                                                                \
+  _DPACK_INSTANTIATE_STATIC(Type)
 
 #define DPACK_DEF_CUSTOM(Type, ...)                                                                \
   void read(Reader& packer, Type& value) {                                                         \
@@ -281,45 +479,67 @@ void read(Reader& reader, T& value) {
   }                                                                                                \
   void write(Writer& packer, const Type& value) {                                                  \
     __VA_ARGS__;                                                                                   \
-  }
+  }                                                                                                \
+  template <static_reader Packer>                                                                  \
+  void read(Packer& packer, Type& value) {                                                         \
+    __VA_ARGS__;                                                                                   \
+  }                                                                                                \
+  template <static_writer Packer>                                                                  \
+  void write(Packer& packer, const Type& value) {                                                  \
+    __VA_ARGS__;                                                                                   \
+  }                                                                                                \
+  _DPACK_INSTANTIATE_STATIC(Type)
 
 #define DPACK_INLINE(Type, ...)                                                                    \
-  inline void read(Reader& packer, Type& value) {                                                  \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_VALUE, __VA_ARGS__)                                                     \
-    packer.object_end();                                                                           \
+  template <reader_type Packer>                                                                    \
+  void read(Packer& packer, Type& value) {                                                         \
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
   }                                                                                                \
-  inline void write(Writer& packer, const Type& value) {                                           \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_VALUE, __VA_ARGS__)                                                     \
-    packer.object_end();                                                                           \
+  template <writer_type Packer>                                                                    \
+  void write(Packer& packer, const Type& value) {                                                  \
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
+  }                                                                                                \
+  template <typename Query>                                                                        \
+  constexpr std::size_t fixed_size(Query, const Type*) {                                           \
+    using Value [[maybe_unused]] = Type;                                                           \
+    return Query::object(std::size_t(0) _DPACK_FOR_EACH(_DPACK_SIZE, __VA_ARGS__));                \
   }
 
 #define DPACK_INLINE_CUSTOM(Type, ...)                                                             \
-  inline void read(Reader& packer, Type& value) {                                                  \
+  template <reader_type Packer>                                                                    \
+  void read(Packer& packer, Type& value) {                                                         \
     __VA_ARGS__;                                                                                   \
   }                                                                                                \
-  inline void write(Writer& packer, const Type& value) {                                           \
+  template <writer_type Packer>                                                                    \
+  void write(Packer& packer, const Type& value) {                                                  \
     __VA_ARGS__;                                                                                   \
   }
 
 // ===================================================================================
 // Class macros
 
+// DPACK_CLASS_DECL() only declares the virtual read/write, so they can also be defined by hand.
+// DPACK_CLASS_DECL_STATIC() also declares templates for the static packers, which
+// DPACK_CLASS_DEF_STATIC() defines and instantiates, so datapack/binary.hpp must be included
+// where it is used.
+
 #define DPACK_CLASS_DECL()                                                                         \
   void read(::dpack::Reader& packer);                                                              \
   void write(::dpack::Writer& packer) const;
 
+#define DPACK_CLASS_DECL_STATIC()                                                                  \
+  DPACK_CLASS_DECL()                                                                               \
+  template <::dpack::static_reader Packer>                                                         \
+  void read(Packer& packer);                                                                       \
+  template <::dpack::static_writer Packer>                                                         \
+  void write(Packer& packer) const;
+
 #define DPACK_CLASS_DEF(Class, ...)                                                                \
   void Class::read(::dpack::Reader& packer) {                                                      \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_CLASS_VALUE, __VA_ARGS__)                                               \
-    packer.object_end();                                                                           \
+    _DPACK_CLASS_OBJECT_BODY(__VA_ARGS__)                                                          \
   }                                                                                                \
   void Class::write(::dpack::Writer& packer) const {                                               \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_CLASS_VALUE, __VA_ARGS__)                                               \
-    packer.object_end();                                                                           \
+    _DPACK_CLASS_OBJECT_BODY(__VA_ARGS__)                                                          \
   }
 
 #define DPACK_CLASS_DEF_CUSTOM(Class, ...)                                                         \
@@ -330,23 +550,41 @@ void read(Reader& reader, T& value) {
     __VA_ARGS__;                                                                                   \
   }
 
+#define DPACK_CLASS_DEF_STATIC(Class, ...)                                                         \
+  DPACK_CLASS_DEF(Class, __VA_ARGS__)                                                              \
+  template <::dpack::static_reader Packer>                                                         \
+  void Class::read(Packer& packer) {                                                               \
+    _DPACK_CLASS_OBJECT_BODY(__VA_ARGS__)                                                          \
+  }                                                                                                \
+  template <::dpack::static_writer Packer>                                                         \
+  void Class::write(Packer& packer) const {                                                        \
+    _DPACK_CLASS_OBJECT_BODY(__VA_ARGS__)                                                          \
+  }                                                                                                \
+  template void Class::read<::dpack::BinaryReader>(::dpack::BinaryReader & packer);                \
+  template void Class::write<::dpack::BinaryWriter>(::dpack::BinaryWriter & packer) const;         \
+  template void Class::write<::dpack::BinarySizeWriter>(::dpack::BinarySizeWriter & packer) const;
+
 #define DPACK_CLASS_INLINE(...)                                                                    \
-  void read(::dpack::Reader& packer) {                                                             \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_CLASS_VALUE, __VA_ARGS__)                                               \
-    packer.object_end();                                                                           \
+  template <::dpack::reader_type Packer>                                                           \
+  void read(Packer& packer) {                                                                      \
+    _DPACK_CLASS_OBJECT_BODY(__VA_ARGS__)                                                          \
   }                                                                                                \
-  void write(::dpack::Writer& packer) const {                                                      \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_CLASS_VALUE, __VA_ARGS__)                                               \
-    packer.object_end();                                                                           \
+  template <::dpack::writer_type Packer>                                                           \
+  void write(Packer& packer) const {                                                               \
+    _DPACK_CLASS_OBJECT_BODY(__VA_ARGS__)                                                          \
+  }                                                                                                \
+  template <typename Query>                                                                        \
+  static constexpr std::size_t fixed_size() {                                                      \
+    return Query::object(std::size_t(0) _DPACK_FOR_EACH(_DPACK_CLASS_SIZE, __VA_ARGS__));          \
   }
 
 #define DPACK_CLASS_INLINE_CUSTOM(...)                                                             \
-  void read(::dpack::Reader& packer) {                                                             \
+  template <::dpack::reader_type Packer>                                                           \
+  void read(Packer& packer) {                                                                      \
     __VA_ARGS__;                                                                                   \
   }                                                                                                \
-  void write(::dpack::Writer& packer) const {                                                      \
+  template <::dpack::writer_type Packer>                                                           \
+  void write(Packer& packer) const {                                                               \
     __VA_ARGS__;                                                                                   \
   }
 
@@ -354,26 +592,22 @@ void read(Reader& reader, T& value) {
 // Templated macros
 
 #define DPACK_TEMPLATED_INLINE(Type, Typenames, ...)                                               \
-  template <_DPACK_DEPAREN(Typenames)>                                                             \
-  void read(Reader& packer, _DPACK_DEPAREN(Type) & value) {                                        \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_VALUE, __VA_ARGS__)                                                     \
-    packer.object_end();                                                                           \
+  template <_DPACK_DEPAREN(Typenames), reader_type Packer>                                         \
+  void read(Packer& packer, _DPACK_DEPAREN(Type) & value) {                                        \
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
   }                                                                                                \
-  template <_DPACK_DEPAREN(Typenames)>                                                             \
-  void write(Writer& packer, const _DPACK_DEPAREN(Type) & value) {                                 \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_VALUE, __VA_ARGS__)                                                     \
-    packer.object_end();                                                                           \
+  template <_DPACK_DEPAREN(Typenames), writer_type Packer>                                         \
+  void write(Packer& packer, const _DPACK_DEPAREN(Type) & value) {                                 \
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
   }
 
 #define DPACK_TEMPLATED_INLINE_CUSTOM(Type, Typenames, ...)                                        \
-  template <_DPACK_DEPAREN(Typenames)>                                                             \
-  void read(Reader& packer, _DPACK_DEPAREN(Type) & value) {                                        \
+  template <_DPACK_DEPAREN(Typenames), reader_type Packer>                                         \
+  void read(Packer& packer, _DPACK_DEPAREN(Type) & value) {                                        \
     __VA_ARGS__;                                                                                   \
   }                                                                                                \
-  template <_DPACK_DEPAREN(Typenames)>                                                             \
-  void write(Writer& packer, const _DPACK_DEPAREN(Type) & value) {                                 \
+  template <_DPACK_DEPAREN(Typenames), writer_type Packer>                                         \
+  void write(Packer& packer, const _DPACK_DEPAREN(Type) & value) {                                 \
     __VA_ARGS__;                                                                                   \
   }
 
@@ -381,20 +615,28 @@ void read(Reader& reader, T& value) {
   template <_DPACK_DEPAREN(Typenames)>                                                             \
   void read(Reader& packer, _DPACK_DEPAREN(Type) & value);                                         \
   template <_DPACK_DEPAREN(Typenames)>                                                             \
-  void write(Writer& packer, const _DPACK_DEPAREN(Type) & value);
+  void write(Writer& packer, const _DPACK_DEPAREN(Type) & value);                                  \
+  template <_DPACK_DEPAREN(Typenames), static_reader Packer>                                       \
+  void read(Packer& packer, _DPACK_DEPAREN(Type) & value);                                         \
+  template <_DPACK_DEPAREN(Typenames), static_writer Packer>                                       \
+  void write(Packer& packer, const _DPACK_DEPAREN(Type) & value);
 
 #define DPACK_TEMPLATED_DEF(Type, Typenames, ...)                                                  \
   template <_DPACK_DEPAREN(Typenames)>                                                             \
   void read(Reader& packer, _DPACK_DEPAREN(Type) & value) {                                        \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_VALUE, __VA_ARGS__)                                                     \
-    packer.object_end();                                                                           \
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
   }                                                                                                \
   template <_DPACK_DEPAREN(Typenames)>                                                             \
   void write(Writer& packer, const _DPACK_DEPAREN(Type) & value) {                                 \
-    packer.object_begin();                                                                         \
-    _DPACK_FOR_EACH(_DPACK_VALUE, __VA_ARGS__)                                                     \
-    packer.object_end();                                                                           \
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
+  }                                                                                                \
+  template <_DPACK_DEPAREN(Typenames), static_reader Packer>                                       \
+  void read(Packer& packer, _DPACK_DEPAREN(Type) & value) {                                        \
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
+  }                                                                                                \
+  template <_DPACK_DEPAREN(Typenames), static_writer Packer>                                       \
+  void write(Packer& packer, const _DPACK_DEPAREN(Type) & value) {                                 \
+    _DPACK_OBJECT_BODY(__VA_ARGS__)                                                                \
   }
 
 #define DPACK_TEMPLATED_DEF_CUSTOM(Type, Typenames, ...)                                           \
@@ -405,10 +647,25 @@ void read(Reader& reader, T& value) {
   template <_DPACK_DEPAREN(Typenames)>                                                             \
   void write(Writer& packer, const _DPACK_DEPAREN(Type) & value) {                                 \
     __VA_ARGS__;                                                                                   \
+  }                                                                                                \
+  template <_DPACK_DEPAREN(Typenames), static_reader Packer>                                       \
+  void read(Packer& packer, _DPACK_DEPAREN(Type) & value) {                                        \
+    __VA_ARGS__;                                                                                   \
+  }                                                                                                \
+  template <_DPACK_DEPAREN(Typenames), static_writer Packer>                                       \
+  void write(Packer& packer, const _DPACK_DEPAREN(Type) & value) {                                 \
+    __VA_ARGS__;                                                                                   \
   }
 
 #define DPACK_TEMPLATED_INSTANTIATE(Type, ...)                                                     \
   template void read<__VA_ARGS__>(Reader & packer, Type<__VA_ARGS__> & value);                     \
-  template void write<__VA_ARGS__>(Writer & packer, const Type<__VA_ARGS__>& value);
+  template void write<__VA_ARGS__>(Writer & packer, const Type<__VA_ARGS__>& value);               \
+  template void read<__VA_ARGS__, BinaryReader>(BinaryReader & packer, Type<__VA_ARGS__> & value); \
+  template void write<__VA_ARGS__, BinaryWriter>(                                                  \
+      BinaryWriter & packer,                                                                       \
+      const Type<__VA_ARGS__>& value);                                                             \
+  template void write<__VA_ARGS__, BinarySizeWriter>(                                              \
+      BinarySizeWriter & packer,                                                                   \
+      const Type<__VA_ARGS__>& value);
 
 } // namespace dpack
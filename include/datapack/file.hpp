@@ -1,7 +1,9 @@
 #pragma once
 
 #include "datapack/binary.hpp"
+#include "datapack/json.hpp"
 #include "datapack/object.hpp"
+#include "datapack/schema/evolution.hpp"
 #include "datapack/schema/schema.hpp"
 #include <fstream>
 #include <string>
@@ -18,39 +20,67 @@ public:
     }
   };
 
-  FileWriter(const std::string& path);
+  // If embed_schemas is set, the schema of each label is written before its first value, so
+  // the values can still be read after the type changes (see FileReader::read())
+  FileWriter(const std::string& path, bool embed_schemas = false);
   void close();
 
+  // Values are streamed to the file through a fixed-size buffer, so the whole chunk is never
+  // held in memory
+
   template <typename T>
   requires writeable<T>
   void write(const std::string& label, const T& value) {
-    check_hash(label, get_hash<T>());
-    write_chunk(label, get_hash<T>(), to_binary(value));
+    if (check_hash(label, get_hash<T>()) && embed_schemas) {
+      write_schema(label, get_schema<T>());
+    }
+    begin_chunk(label, get_hash<T>());
+    BinaryWriter writer(os, buffer);
+    writer.value(value);
+    writer.finish();
+    end_chunk(writer.pos());
   }
 
   void write_object(const std::string& label, const Object& object, const Schema& schema) {
-    check_hash(label, schema.hash());
+    if (check_hash(label, schema.hash()) && embed_schemas) {
+      write_schema(label, schema);
+    }
+    begin_chunk(label, schema.hash());
 
     ObjectReader reader(object);
-    BinarySizeWriter size_writer;
-    schema.apply(reader, size_writer);
-
-    std::vector<std::uint8_t> buffer(size_writer.size());
-    BinaryWriter binary_writer(buffer);
+    BinaryWriter binary_writer(os, buffer);
     schema.apply(reader, binary_writer);
+    binary_writer.finish();
+
+    end_chunk(binary_writer.pos());
+  }
 
-    write_chunk(label, schema.hash(), buffer);
+  // Converts the JSON straight to binary, without an intermediate Object. The binary is held in
+  // memory until the conversion succeeds, so invalid JSON (which throws JsonLoadError or
+  // SchemaError) leaves the file unchanged.
+  void write_json(const std::string& label, const std::string& json, const Schema& schema) {
+    const std::vector<std::uint8_t> data = json_to_binary(schema, json);
+
+    if (check_hash(label, schema.hash()) && embed_schemas) {
+      write_schema(label, schema);
+    }
+    begin_chunk(label, schema.hash());
+    os.write((const char*)data.data(), data.size());
+    end_chunk(data.size());
   }
 
 private:
-  void check_hash(const std::string& label, std::uint64_t hash);
-  void write_chunk(
-      const std::string& label,
-      std::uint64_t hash,
-      const std::vector<std::uint8_t>& data);
+  // Returns true if this is the first value with the label
+  bool check_hash(const std::string& label, std::uint64_t hash);
+  void write_schema(const std::string& label, const Schema& schema);
+  void begin_chunk(const std::string& label, std::uint64_t hash, bool schema_chunk = false);
+  void end_chunk(std::uint64_t data_size);
 
   std::ofstream os;
+  bool embed_schemas;
   std::unordered_map<std::string, std::uint64_t> label_hashes;
+  std::vector<std::uint8_t> buffer; // Reused between chunks
+  std::streampos data_size_pos;
 };
 
 class FileReader {
@@ -71,37 +101,175 @@ public:
   FileReader(const std::string& path);
   void close();
 
+  // Moves to the next value, returning its label, or nullopt at the end of the file
   std::optional<std::string> next();
 
+  // Values are streamed from the file through a buffer, which only grows if a single string or
+  // binary value doesn't fit. Borrowed values (eg: std::string_view) can only be read from
+  // values that fit in the buffer (at least 64 KiB), and are valid until the next value is
+  // read.
+  // If the type has changed since the value was written, and the file contains the schema it
+  // was written with, the value is converted instead (see SchemaEvolutionReader). This reads
+  // the whole value into the buffer.
+
   template <typename T>
   requires readable<T>
   T read() {
-    auto [hash, bytes] = read_chunk_remainder();
-    check_hash(hash, current_label, get_hash<T>());
-    return from_binary<T>(bytes);
+    T result;
+    if (!current_matches(get_schema<T>())) {
+      SchemaEvolutionReader reader(current_schema(), read_chunk_data());
+      reader.value(result);
+      if (!reader.valid()) {
+        throw TypeError();
+      }
+      return result;
+    }
+    BinaryReader reader = chunk_reader();
+    reader.value(result);
+    end_chunk(reader);
+    return result;
   }
 
   Object read_object(const std::string& label, const Schema& schema) {
-    auto [hash, bytes] = read_chunk_remainder();
-    check_hash(hash, current_label, schema.hash());
+    check_schema(schema);
 
-    BinaryReader reader(bytes);
+    BinaryReader reader = chunk_reader();
     Object object;
     ObjectWriter writer(object);
     schema.apply(reader, writer);
+    end_chunk(reader);
 
     return object;
   }
 
+  // Streams the chunk to the output as JSON, without an intermediate Object, so memory use
+  // doesn't depend on the size of the chunk
+  void read_json(const Schema& schema, std::ostream& os, bool pretty = true) {
+    check_schema(schema);
+
+    BinaryReader reader = chunk_reader();
+    JsonWriter writer(os, pretty);
+    schema.apply(reader, writer);
+    writer.finish();
+    end_chunk(reader);
+  }
+
   void skip();
 
 private:
-  void check_hash(std::uint64_t stored_hash, const std::string& label, std::uint64_t expected_hash);
-  std::tuple<std::uint64_t, std::vector<std::uint8_t>> read_chunk_remainder();
+  // The hash doesn't depend on the order of object members, so if the file contains the schema
+  // the value was written with, that is compared too
+  bool current_matches(const Schema& schema) const;
+  void check_schema(const Schema& schema) const;
+  const Schema& current_schema();
+  BinaryReader chunk_reader();
+  std::span<const std::uint8_t> read_chunk_data();
+  void end_chunk(const BinaryReader& reader);
 
   std::ifstream is;
   std::string current_label;
+  std::uint64_t current_hash;
   std::unordered_map<std::string, std::uint64_t> label_hashes;
+  std::unordered_map<std::string, Schema> label_schemas; // If written with the file
+  std::vector<std::uint8_t> buffer; // Reused between chunks
+  std::uint64_t chunk_remaining;
+  std::size_t alignment; // Of chunk data, which older files don't pad
+};
+
+// Reads values by label from a memory-mapped file, for large files where only a few values are
+// needed. Opening the file indexes the chunks by reading each chunk header and jumping over its
+// data, so reading a value doesn't read anything before it.
+// Values are decoded straight from the mapping, so borrowed views (eg: std::string_view) stay
+// valid until the reader is closed. Chunk data is 8-byte aligned in the file, so number spans
+// (eg: std::span<const double>) can be borrowed too, except from files written before chunks
+// were aligned.
+class MappedFileReader {
+public:
+  using TypeError = FileReader::TypeError;
+  using FileError = FileReader::FileError;
+
+  MappedFileReader(const std::string& path);
+  ~MappedFileReader();
+  MappedFileReader(const MappedFileReader&) = delete;
+  MappedFileReader& operator=(const MappedFileReader&) = delete;
+  void close();
+
+  // Labels in the order they first appear in the file
+  const std::vector<std::string>& labels() const {
+    return label_order;
+  }
+  // Number of values with the label
+  std::size_t count(const std::string& label) const;
+
+  // Reads the index'th value with the label, throwing std::out_of_range if there isn't one, or
+  // FileError if the reader is closed.
+  // As with FileReader::read(), values written with an earlier version of the type are
+  // converted if the file contains their schema.
+
+  template <typename T>
+  requires readable<T>
+  T read(const std::string& label, std::size_t index = 0) const {
+    const Chunk& chunk = find_chunk(label, index);
+    T result;
+    if (!chunk_matches(label, chunk, get_schema<T>())) {
+      SchemaEvolutionReader reader(label_schema(label, chunk.hash), chunk_data(chunk));
+      reader.value(result);
+      if (!reader.valid()) {
+        throw TypeError();
+      }
+      return result;
+    }
+    BinaryReader reader(chunk_data(chunk));
+    reader.value(result);
+    if (!reader.valid()) {
+      throw FileError();
+    }
+    return result;
+  }
+
+  Object read_object(const std::string& label, const Schema& schema, std::size_t index = 0)
+      const {
+    const Chunk& chunk = find_chunk(label, index);
+    if (!chunk_matches(label, chunk, schema)) {
+      throw TypeError();
+    }
+
+    BinaryReader reader(chunk_data(chunk));
+    Object object;
+    ObjectWriter writer(object);
+    schema.apply(reader, writer);
+    if (!reader.valid()) {
+      throw FileError();
+    }
+
+    return object;
+  }
+
+private:
+  struct Chunk {
+    std::uint64_t hash;
+    std::size_t begin;
+    std::size_t size;
+  };
+  struct LabelIndex {
+    std::vector<Chunk> chunks;
+    std::optional<Schema> schema; // If written with the file
+  };
+
+  void build_index();
+  const Chunk& find_chunk(const std::string& label, std::size_t index) const;
+  // As for FileReader::current_matches()
+  bool chunk_matches(const std::string& label, const Chunk& chunk, const Schema& schema) const;
+  const Schema& label_schema(const std::string& label, std::uint64_t hash) const;
+  std::span<const std::uint8_t> chunk_data(const Chunk& chunk) const {
+    return std::span<const std::uint8_t>(data + chunk.begin, chunk.size);
+  }
+
+  const std::uint8_t* data;
+  std::size_t size;
+  std::unordered_map<std::string, LabelIndex> index;
+  std::vector<std::string> label_order;
+  std::size_t alignment; // As for FileReader
 };
 
 template <typename T>
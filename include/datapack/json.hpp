@@ -1,6 +1,11 @@
 #pragma once
 
+#include "datapack/binary.hpp"
 #include "datapack/object.hpp"
+#include "datapack/schema/schema.hpp"
+#include <fstream>
+#include <sstream>
+#include <string_view>
 
 namespace dpack {
 
@@ -9,40 +14,154 @@ public:
   JsonLoadError(const std::string& message) : std::runtime_error(message) {}
 };
 
+// Reads JSON directly into a type, parsing the input on demand instead of building an Object.
+// Keys may be in any order. Syntax errors and mismatched containers throw JsonLoadError,
+// while other values that don't match the type invalidate the reader.
+// The json string must outlive the reader.
+class JsonReader : public Reader {
+public:
+  JsonReader(const std::string& json);
+  JsonReader(std::string&&) = delete;
+
+  void number(NumberType type, void* value) override;
+  bool boolean() override;
+  const char* string() override;
+  int enumerate(const std::span<const char*>& labels) override;
+  std::span<const std::uint8_t> binary() override;
+
+  bool optional_begin() override;
+  void optional_end() override;
+
+  int variant_begin(const std::span<const char*>& labels) override;
+  void variant_end() override;
+
+  void object_begin() override;
+  void object_end() override;
+  bool object_next(const char* key) override;
+
+  void tuple_begin() override;
+  void tuple_end() override;
+  void tuple_next() override;
+
+  size_t list_begin() override;
+  void list_next() override;
+  void list_end() override;
+
+private:
+  char peek();
+  void expect(char c);
+  bool consume(char c);
+  bool consume_literal(const char* literal);
+  std::string_view parse_string();
+  bool find_key(const char* key);
+  void skip_value();
+
+  std::string_view json;
+  std::size_t pos;
+  std::vector<std::size_t> objects; // Start of each object being read
+  // If a key was missing, the depth of the object it was missing from. Reads are skipped until
+  // the next key of that object.
+  std::size_t missing_depth;
+  std::string string_temp;
+  std::vector<std::uint8_t> data_temp;
+};
+
+// Writes JSON directly as the value is traversed, instead of building an Object first.
+// Pretty output matches dump_json(), while compact output has no whitespace.
+class JsonWriter : public Writer {
+public:
+  // Appends to the string
+  JsonWriter(std::string& json, bool pretty = true);
+  // Writes to the stream, buffering output between calls. Call finish() once done to flush.
+  JsonWriter(std::ostream& os, bool pretty = true);
+
+  void number(NumberType type, const void* value) override;
+  void boolean(bool value) override;
+  void string(const char* value) override;
+  void enumerate(int value, const std::span<const char*>& labels) override;
+  void binary(const std::span<const std::uint8_t>& data) override;
+
+  void optional_begin(bool has_value) override;
+  void optional_end() override;
+
+  void variant_begin(int value, const std::span<const char*>& labels) override;
+  void variant_end() override;
+
+  void object_begin() override;
+  void object_next(const char* key) override;
+  void object_end() override;
+
+  void tuple_begin() override;
+  void tuple_next() override;
+  void tuple_end() override;
+
+  void list_begin(size_t size) override;
+  void list_next() override;
+  void list_end() override;
+
+  void finish();
+
+private:
+  void container_begin(char c);
+  void container_next();
+  void container_end(char c);
+  void indent();
+
+  std::string buffer;
+  std::string& json;
+  std::ostream* os;
+  bool pretty;
+  std::size_t depth;
+  bool is_first; // Following the start of a container
+};
+
 Object load_json(const std::string& json);
 std::string dump_json(ConstObject object);
 
 Object load_json_file(const std::string& file);
 void dump_json_file(ConstObject object, const std::string& file);
 
+// Convert between binary data and JSON using only a schema, streaming from one to the other
+// without the C++ type or an intermediate Object. Data that doesn't match the schema throws
+// SchemaError, while invalid JSON syntax throws JsonLoadError.
+
+std::string binary_to_json(
+    const Schema& schema,
+    const std::span<const std::uint8_t>& data,
+    bool pretty = true);
+// Reads from the input stream and writes to the output stream through fixed-size buffers
+void binary_to_json(const Schema& schema, std::istream& is, std::ostream& os, bool pretty = true);
+
+std::vector<std::uint8_t> json_to_binary(const Schema& schema, const std::string& json);
+
 template <readable T>
 T from_json(const std::string& json) {
-  Object object = load_json(json);
   T result;
-  ObjectReader(object).value(result);
+  JsonReader(json).value(result);
   return result;
 }
 
 template <writeable T>
-std::string to_json(const T& value) {
-  Object object;
-  ObjectWriter(object).value(value);
-  return dump_json(object);
+std::string to_json(const T& value, bool pretty = true) {
+  std::string json;
+  JsonWriter(json, pretty).value(value);
+  return json;
 }
 
 template <readable T>
 T from_json_file(const std::string& file) {
-  Object object = load_json_file(file);
-  T result;
-  ObjectReader(object).value(result);
-  return result;
+  std::ifstream is(file);
+  std::stringstream ss;
+  ss << is.rdbuf();
+  return from_json<T>(ss.str());
 }
 
 template <writeable T>
-void to_json_file(const T& value, const std::string& file) {
-  Object object;
-  ObjectWriter(object).value(value);
-  dump_json_file(object, file);
+void to_json_file(const T& value, const std::string& file, bool pretty = true) {
+  std::ofstream os(file);
+  JsonWriter writer(os, pretty);
+  writer.value(value);
+  writer.finish();
 }
 
 } // namespace dpack
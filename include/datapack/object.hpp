@@ -1,6 +1,7 @@
 #pragma once
 
 #include "datapack/datapack.hpp"
+#include <array>
 #include <assert.h>
 #include <concepts>
 #include <initializer_list>
@@ -9,7 +10,9 @@
 #include <stack>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -75,51 +78,321 @@ public:
 // ===================================
 // Node and Tree
 
+// Alternatives of value_t, in the same order
+enum class NodeType : std::uint8_t { Number, Boolean, String, Binary, Null, Map, List };
+
+template <typename T>
+constexpr NodeType node_type() {
+  if constexpr (std::is_same_v<T, number_t>) {
+    return NodeType::Number;
+  } else if constexpr (std::is_same_v<T, bool>) {
+    return NodeType::Boolean;
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    return NodeType::String;
+  } else if constexpr (std::is_same_v<T, binary_t>) {
+    return NodeType::Binary;
+  } else if constexpr (std::is_same_v<T, null_t>) {
+    return NodeType::Null;
+  } else if constexpr (std::is_same_v<T, map_t>) {
+    return NodeType::Map;
+  } else {
+    static_assert(std::is_same_v<T, list_t>);
+    return NodeType::List;
+  }
+}
+
+// Nodes are kept small so that traversing a tree stays cache friendly. Keys, strings and
+// binary data are owned by the Tree, and nodes refer to them by index.
 struct Node {
-  value_t value;
-  std::string key;
+  union {
+    number_t number;
+    bool boolean;
+    int data; // Index into the tree strings or binaries
+  };
+  NodeType type;
+  int key; // Index into the tree keys
   int parent;
   int child;
+  int last_child;
+  int child_count;
   int prev;
   int next;
-  Node(const value_t& value, const std::string& key, int parent, int prev) :
-      value(value), key(key), parent(parent), child(-1), prev(prev), next(-1) {}
 };
 
+// A vector split into fixed size pages, which are shared between copies of the vector until they
+// are written to. Copying the vector only copies the page table, and modifying an element copies
+// at most one page.
+// Pages with an element given out by reference (see ref()) are the exception, and are copied
+// rather than shared until release_refs(), since the reference could still be used to modify the
+// page.
+template <typename T, std::size_t PageSize>
+class PagedVector {
+public:
+  PagedVector() = default;
+  PagedVector(PagedVector&&) = default;
+  PagedVector& operator=(PagedVector&&) = default;
+
+  PagedVector(const PagedVector& other) :
+      pages(other.pages), referenced(other.pages.size(), false), size_(other.size_) {
+    for (std::size_t i = 0; i < pages.size(); i++) {
+      if (other.referenced[i]) {
+        pages[i] = std::make_shared<Page>(*pages[i]);
+      }
+    }
+  }
+
+  PagedVector& operator=(const PagedVector& other) {
+    return *this = PagedVector(other);
+  }
+
+  std::size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  const T& operator[](std::size_t i) const {
+    return (*pages[i / PageSize])[i % PageSize];
+  }
+
+  // Access an element for modification, first copying its page if it is shared
+  T& mut(std::size_t i) {
+    std::shared_ptr<Page>& page = pages[i / PageSize];
+    if (page.use_count() > 1) {
+      page = std::make_shared<Page>(*page);
+    }
+    return (*page)[i % PageSize];
+  }
+
+  // As above, for a reference that may outlive the call, so the page isn't shared again until
+  // release_refs()
+  T& ref(std::size_t i) {
+    const std::size_t page = i / PageSize;
+    if (!referenced[page]) {
+      referenced[page] = true;
+      referenced_pages.push_back(page);
+    }
+    return mut(i);
+  }
+
+  // Called once all references from ref() are invalid, so their pages can be shared again
+  void release_refs() {
+    for (std::size_t page : referenced_pages) {
+      referenced[page] = false;
+    }
+    referenced_pages.clear();
+  }
+
+  void push_back(T value) {
+    if (size_ % PageSize == 0) {
+      pages.push_back(std::make_shared<Page>());
+      referenced.push_back(false);
+    }
+    (*pages.back())[size_ % PageSize] = std::move(value);
+    size_++;
+  }
+
+  void reserve(std::size_t size) {
+    pages.reserve((size + PageSize - 1) / PageSize);
+    referenced.reserve((size + PageSize - 1) / PageSize);
+  }
+
+private:
+  using Page = std::array<T, PageSize>;
+  std::vector<std::shared_ptr<Page>> pages;
+  std::vector<bool> referenced;
+  std::vector<std::size_t> referenced_pages;
+  std::size_t size_ = 0;
+};
+
+// Copying a tree is cheap: the copy shares all storage with the original, and each tree copies
+// a page of storage the first time it modifies it, so a snapshot costs O(changes) rather than
+// O(size). Indexes and keys are shared the same way, per index and as a whole respectively.
+// A mutable value reference from get_if() or get() keeps its page from being shared until the
+// next structural change (any other public modifier), which invalidates the reference.
 class Tree {
 public:
+  Tree();
+
   const Node& operator[](std::size_t i) const {
     return nodes[i];
   }
-  Node& operator[](std::size_t i) {
-    return nodes[i];
-  }
 
   std::size_t size() const {
     return nodes.size() - free.size();
   }
 
-  void set_node(int index, const value_t& value);
+  // The number of node indices in use, including free nodes
+  std::size_t capacity() const {
+    return nodes.size();
+  }
+
+  template <typename T>
+  bool holds(int node) const {
+    return nodes[node].type == node_type<T>();
+  }
+
+  template <typename T>
+  T* get_if(int node) {
+    if (!holds<T>(node)) {
+      return nullptr;
+    }
+    if constexpr (std::is_same_v<T, number_t>) {
+      return &nodes.ref(node).number;
+    } else if constexpr (std::is_same_v<T, bool>) {
+      return &nodes.ref(node).boolean;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      return &strings.ref(nodes[node].data);
+    } else {
+      static_assert(std::is_same_v<T, binary_t>);
+      return &binaries.ref(nodes[node].data);
+    }
+  }
+
+  template <typename T>
+  const T* get_if(int node) const {
+    if (!holds<T>(node)) {
+      return nullptr;
+    }
+    if constexpr (std::is_same_v<T, number_t>) {
+      return &nodes[node].number;
+    } else if constexpr (std::is_same_v<T, bool>) {
+      return &nodes[node].boolean;
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      return &strings[nodes[node].data];
+    } else {
+      static_assert(std::is_same_v<T, binary_t>);
+      return &binaries[nodes[node].data];
+    }
+  }
+
+  template <typename T>
+  T& get(int node) {
+    if (auto value = get_if<T>(node)) {
+      return *value;
+    }
+    throw std::bad_variant_access();
+  }
+
+  template <typename T>
+  const T& get(int node) const {
+    if (auto value = get_if<T>(node)) {
+      return *value;
+    }
+    throw std::bad_variant_access();
+  }
+
+  const std::string& key(int node) const {
+    return key_table->keys[nodes[node].key];
+  }
+
+  // Change the key of a map element, throwing a KeyError if a sibling already has the key
+  void rename_node(int node, const std::string& key);
+
+  void set_node(int index, value_t value);
   void clear_node(int index);
   void erase_node(int index);
-  int insert_node(const value_t& value, const std::string& key, int parent, int prev);
+  int insert_node(value_t value, const std::string& key, int parent, int prev);
   void copy_node(int to, const Tree& nodes_from, int from);
 
   int find_map_node(int root, const std::string& key, bool required = true) const;
   int find_or_create_map_node(int root, const std::string& key);
-  int insert_map_node(int root, const std::string& key, const value_t& value);
+  int insert_map_node(int root, const std::string& key, value_t value);
 
   int find_list_node(int root, std::size_t index) const;
-  int insert_list_node(int root, const value_t& value);
+  // Also rebuilds the list's index if it was dropped (see list_index_threshold)
+  int find_list_node(int root, std::size_t index);
+  int insert_list_node(int root, value_t value);
 
   std::size_t node_child_count(int node) const;
 
+  // Rewrite the nodes depth-first from the root (node 0), dropping free nodes, strings,
+  // binaries and keys. This restores locality after many erasures, but changes the index of
+  // every node other than the root.
+  void compact();
+
+  // True if at least half of the node storage is free, in a tree of at least compact_min_nodes.
+  // The tree compacts itself if this holds after the root is overwritten or merged into (see
+  // object_merge_into), since handles to other nodes aren't expected to stay valid then.
+  bool fragmented() const;
+  static constexpr std::size_t compact_min_nodes = 1024;
+
+  // The number of interned keys, including keys no longer used by any node. Erasing nodes
+  // doesn't move any others, but once at least half of the keys are unused (and there are at
+  // least compact_min_nodes), the key table is rebuilt.
+  std::size_t key_capacity() const {
+    return key_table->keys.size();
+  }
+
+  // Maps with at least this many children get a hashed key index, built when an insertion
+  // reaches the threshold, so lookup and duplicate checks don't have to walk the children.
+  static constexpr std::size_t map_index_threshold = 16;
+
+  // Similarly, lists with at least this many children get an index for random access.
+  // Inserting or erasing anywhere but the end drops the index rather than shifting it, and the
+  // next indexed access through a mutable tree rebuilds it.
+  static constexpr std::size_t list_index_threshold = 64;
+
+  bool map_indexed(int root) const {
+    return find_map_index(root) != nullptr;
+  }
+  bool list_indexed(int root) const {
+    return find_list_index(root) != nullptr;
+  }
+
 private:
-  int emplace_node(const value_t& value, const std::string& key, int parent, int prev);
+  using MapIndex = std::unordered_multimap<std::size_t, int>; // Key hash -> child node
+  using ListIndex = std::vector<int>;                         // Child nodes in order
+
+  // Keys are interned, so nodes with the same key share it, including after a rename
+  struct KeyTable {
+    std::vector<std::string> keys;
+    std::unordered_map<std::string, int> key_ids;
+  };
+
+  void release_refs();
+
+  int emplace_node(int key, int parent, int prev);
+  void link_node(int node);
   void pop_node(int index);
 
-  std::vector<Node> nodes;
+  void set_value(int index, value_t&& value);
+  void copy_value(int index, const Tree& tree_from, int from);
+  void release_value(int index);
+  int store_string(std::string&& string);
+  int store_binary(binary_t&& binary);
+
+  KeyTable& mutable_key_table();
+  void compact_keys();
+  void compact_unused_keys();
+  int intern_key(const std::string& key);
+  int copy_key(const Tree& tree_from, int from);
+
+  const MapIndex* find_map_index(int root) const;
+  MapIndex* find_mutable_map_index(int root);
+  int find_indexed_node(const MapIndex& index, const std::string& key) const;
+  void erase_indexed_node(MapIndex& index, int node) const;
+  void create_map_index(int root);
+
+  const ListIndex* find_list_index(int root) const;
+  ListIndex* find_mutable_list_index(int root);
+  void create_list_index(int root);
+
+  // Binaries can be large, so each has its own page
+  PagedVector<Node, 256> nodes;
+  PagedVector<std::string, 64> strings;
+  PagedVector<binary_t, 1> binaries;
+
+  // Unused nodes, strings and binaries are cleared and kept in a free list
   std::vector<int> free;
+  std::vector<int> free_strings;
+  std::vector<int> free_binaries;
+
+  std::shared_ptr<KeyTable> key_table;
+
+  std::unordered_map<int, std::shared_ptr<MapIndex>> map_indexes;
+  std::unordered_map<int, std::shared_ptr<ListIndex>> list_indexes;
 };
 
 // ===================================
@@ -137,6 +410,85 @@ class Ptr_;
 using Ptr = Ptr_<false>;
 using ConstPtr = Ptr_<true>;
 
+class ObjectHashes;
+struct TreeRef;
+
+// ===================================
+// KeyRef
+
+// Mutable reference to the key of a map element. Keys are interned and indexed by the parent,
+// so they can't be modified in place. Instead, assigning to the key or one of its characters
+// renames the element (see Tree::rename_node()).
+class KeyRef {
+public:
+  class CharRef {
+  public:
+    operator char() const {
+      return tree->key(node)[index];
+    }
+    CharRef& operator=(char c) {
+      std::string renamed = tree->key(node);
+      renamed[index] = c;
+      tree->rename_node(node, renamed);
+      return *this;
+    }
+
+  private:
+    CharRef(std::shared_ptr<Tree> tree, int node, std::size_t index) :
+        tree(std::move(tree)), node(node), index(index) {}
+    std::shared_ptr<Tree> tree;
+    int node;
+    std::size_t index;
+    friend class KeyRef;
+  };
+
+  KeyRef(std::shared_ptr<Tree> tree, int node) : tree(std::move(tree)), node(node) {}
+
+  const std::string& str() const {
+    return tree->key(node);
+  }
+  operator const std::string&() const {
+    return str();
+  }
+
+  KeyRef& operator=(const std::string& key) {
+    tree->rename_node(node, key);
+    return *this;
+  }
+  // Assigns the key, not the reference
+  KeyRef& operator=(const KeyRef& other) {
+    return *this = std::string(other.str());
+  }
+  KeyRef(const KeyRef& other) = default;
+
+  CharRef operator[](std::size_t index) const {
+    return CharRef(tree, node, index);
+  }
+  std::size_t size() const {
+    return str().size();
+  }
+  bool empty() const {
+    return str().empty();
+  }
+  const char* c_str() const {
+    return str().c_str();
+  }
+
+  friend bool operator==(const KeyRef& lhs, std::string_view rhs) {
+    return lhs.str() == rhs;
+  }
+  friend std::ostream& operator<<(std::ostream& os, const KeyRef& key) {
+    return os << key.str();
+  }
+
+private:
+  std::shared_ptr<Tree> tree;
+  int node;
+};
+
+template <bool Const>
+using key_ref_t = std::conditional_t<Const, const std::string&, KeyRef>;
+
 // ===================================
 // ItemsWrapper
 
@@ -148,15 +500,26 @@ class Item {
 public:
   Item(shared_ptr_t<Const, Tree> tree, int node) : tree(tree), node(node) {}
 
-  const_ref_t<Const, std::string> key() const {
-    return (*tree)[node].key;
+  // For mutable objects, assigning to the key renames the element
+  key_ref_t<Const> key() const {
+    if constexpr (Const) {
+      return tree->key(node);
+    } else {
+      return KeyRef(tree, node);
+    }
+  }
+
+  // Changes the key of a map element, keeping the parent's key index up to date
+  void rename(const std::string& key) const {
+    static_assert(!Const);
+    tree->rename_node(node, key);
   }
 
   Object_<Const> value() const;
 
   template <std::size_t Index>
   requires(Index <= 2)
-  std::conditional_t<Index == 0, const_ref_t<Const, std::string>, Object_<Const>> get() const;
+  std::conditional_t<Index == 0, key_ref_t<Const>, Object_<Const>> get() const;
 
 private:
   shared_ptr_t<Const, Tree> tree;
@@ -231,7 +594,7 @@ public:
 
 private:
   void assert_map() const {
-    if (!std::get_if<map_t>(&(*tree)[node].value)) {
+    if (!tree->template holds<map_t>(node)) {
       throw TypeError("Cannot create an items wrapper on a non-map node");
     }
   }
@@ -254,7 +617,7 @@ struct tuple_size<::dpack::object::Item<Const>> {
 
 template <bool Const>
 struct tuple_element<0, ::dpack::object::Item<Const>> {
-  using type = dpack::object::const_ref_t<Const, std::string>;
+  using type = ::dpack::object::key_ref_t<Const>;
 };
 
 template <bool Const>
@@ -322,7 +685,7 @@ public:
 
 private:
   void assert_container() const {
-    if (!std::get_if<map_t>(&(*tree)[node].value) && !std::get_if<list_t>(&(*tree)[node].value)) {
+    if (!tree->template holds<map_t>(node) && !tree->template holds<list_t>(node)) {
       throw TypeError("Cannot create a values wrapper on a non-container node");
     }
   }
@@ -336,12 +699,23 @@ private:
 
 #define OBJECT_PRIMITIVE_METHODS(Type, name)                                                       \
   const_ref_t<Const, Type> name() const {                                                          \
-    return std::get<Type>((*tree)[node].value);                                                    \
+    return tree->template get<Type>(node);                                                         \
   }                                                                                                \
   const_ptr_t<Const, Type> name##_if() const {                                                     \
-    return std::get_if<Type>(&(*tree)[node].value);                                                \
+    return tree->template get_if<Type>(node);                                                      \
   }
 
+template <primitive_arg T>
+value_t primitive_to_value(T value) {
+  if constexpr (std::is_same_v<T, int>) {
+    return double(value);
+  } else if constexpr (std::is_same_v<T, const char*>) {
+    return std::string(value);
+  } else {
+    return std::move(value);
+  }
+}
+
 template <bool Const>
 class Object_ {
   Object_(shared_ptr_t<Const, Tree> tree, int node) : tree(tree), node(node) {}
@@ -360,15 +734,7 @@ public:
   template <primitive_arg T>
   Object_(T value) : tree(std::make_shared<Tree>()), node(0) {
     auto mutable_tree = std::const_pointer_cast<Tree>(tree);
-    if constexpr (std::is_same_v<T, const char*>) {
-      mutable_tree->insert_node(std::string(value), "", -1, -1);
-    }
-    if constexpr (std::is_same_v<T, int>) {
-      mutable_tree->insert_node(double(value), "", -1, -1);
-    }
-    if constexpr (!std::is_same_v<T, const char*> && !std::is_same_v<T, int>) {
-      mutable_tree->insert_node(value, "", -1, -1);
-    }
+    mutable_tree->insert_node(primitive_to_value(std::move(value)), "", -1, -1);
   }
 
   template <primitive_arg T>
@@ -376,15 +742,7 @@ public:
     auto mutable_tree = std::const_pointer_cast<Tree>(tree);
     int list_node = mutable_tree->insert_node(list_t(), "", -1, -1);
     for (const auto& value : list) {
-      if constexpr (std::is_same_v<T, const char*>) {
-        mutable_tree->insert_list_node(list_node, std::string(value));
-      }
-      if constexpr (std::is_same_v<T, int>) {
-        mutable_tree->insert_list_node(list_node, double(value));
-      }
-      if constexpr (!std::is_same_v<T, const char*> && !std::is_same_v<T, int>) {
-        mutable_tree->insert_list_node(list_node, value);
-      }
+      mutable_tree->insert_list_node(list_node, primitive_to_value(T(value)));
     }
   }
 
@@ -406,6 +764,8 @@ public:
     }
   }
 
+  // Cloning (or assigning from) a root object doesn't copy its contents. The two trees share
+  // storage until modified, see Tree.
   Object_ clone() const {
     Object_ result;
     result = (*this);
@@ -443,13 +803,14 @@ public:
     return *this;
   }
 
-#if 0
-  const Object_& operator=(primitive_t value) const {
+  // Primitives are taken by value and moved into the tree, avoiding the temporary tree that
+  // converting to an Object would create
+  template <primitive_arg T>
+  const Object_& operator=(T value) const {
     static_assert(!Const);
-    tree->set_node(node, primitive_to_value(value));
+    tree->set_node(node, primitive_to_value(std::move(value)));
     return *this;
   }
-#endif
 
   Object_ operator[](const std::string& key) const {
     if constexpr (!Const) {
@@ -480,22 +841,22 @@ public:
     return tree->find_map_node(node, key, false) != -1;
   }
 
-#if 0
-  Object_ insert(const std::string& key, const primitive_t& value) const {
+  template <primitive_arg T>
+  Object_ insert(const std::string& key, T value) const {
     if (is_null()) {
       tree->set_node(node, map_t());
     }
-    int new_node = tree->insert_map_node(node, key, primitive_to_value(value));
+    int new_node = tree->insert_map_node(node, key, primitive_to_value(std::move(value)));
     return Object_(tree, new_node);
   }
-  Object_ push_back(const primitive_t& value) {
+  template <primitive_arg T>
+  Object_ push_back(T value) const {
     if (is_null()) {
       tree->set_node(node, list_t());
     }
-    int new_node = tree->insert_list_node(node, primitive_to_value(value));
+    int new_node = tree->insert_list_node(node, primitive_to_value(std::move(value)));
     return Object_(tree, new_node);
   }
-#endif
 
   Object_ insert(const std::string& key, const ConstObject& value) const {
     if (is_null()) {
@@ -533,18 +894,28 @@ public:
     tree->erase_node(node);
   }
 
+  // See Tree::compact(). Handles to any nodes other than the root are invalidated, so this can
+  // only be called on the root.
+  void compact() const {
+    static_assert(!Const);
+    if ((*tree)[node].parent != -1) {
+      throw UsageError("Can only call compact() on the root object");
+    }
+    tree->compact();
+  }
+
   std::size_t size() const {
     return tree->node_child_count(node);
   }
 
   bool is_map() const {
-    return std::get_if<map_t>(&(*tree)[node].value);
+    return tree->template holds<map_t>(node);
   }
   bool is_list() const {
-    return std::get_if<list_t>(&(*tree)[node].value);
+    return tree->template holds<list_t>(node);
   }
   bool is_null() const {
-    return std::get_if<null_t>(&(*tree)[node].value);
+    return tree->template holds<null_t>(node);
   }
   bool is_primitive() const {
     return !is_map() && !is_list() && !is_null();
@@ -596,6 +967,9 @@ private:
 
   template <bool Const_>
   friend class ValuesIterator_;
+
+  friend class ObjectHashes;
+  friend struct TreeRef;
 };
 
 template <bool Const>
@@ -606,11 +980,10 @@ Object_<Const> Item<Const>::value() const {
 template <bool Const>
 template <std::size_t Index>
 requires(Index <= 2)
-std::conditional_t<Index == 0, const_ref_t<Const, std::string>, Object_<Const>> Item<Const>::get()
-    const {
+std::conditional_t<Index == 0, key_ref_t<Const>, Object_<Const>> Item<Const>::get() const {
   static_assert(Index <= 2);
   if constexpr (Index == 0) {
-    return (*tree)[node].key;
+    return key();
   }
   if constexpr (Index == 1) {
     return Object_<Const>(tree, node);
@@ -646,8 +1019,16 @@ public:
   Ptr_ next() const {
     return Ptr_(object.tree, (*object.tree)[object.node].next);
   }
-  const_ref_t<Const, std::string> key() const {
-    return (*object.tree)[object.node].key;
+  key_ref_t<Const> key() const {
+    if constexpr (Const) {
+      return object.tree->key(object.node);
+    } else {
+      return KeyRef(object.tree, object.node);
+    }
+  }
+  void rename(const std::string& key) const {
+    static_assert(!Const);
+    object.tree->rename_node(object.node, key);
   }
 
   Ptr_() : object(nullptr, -1) {}
@@ -710,6 +1091,40 @@ Ptr_<Const> ValuesIterator_<Const>::operator->() const {
 
 std::ostream& operator<<(std::ostream& os, ConstObject ref);
 bool operator==(ConstObject lhs, ConstObject rhs);
+
+// The tree and node of an object. Algorithms that walk large trees use this to access the tree
+// directly, since stepping between handles copies the shared pointer to the tree each time.
+struct TreeRef {
+  TreeRef(ConstObject object) : tree(*object.tree), node(object.node) {}
+  const Tree& tree;
+  int node;
+};
+
+// Two independent 64-bit hashes, so that objects with equal hashes can be treated as equal
+struct ObjectHash {
+  std::uint64_t low;
+  std::uint64_t high;
+  bool operator==(const ObjectHash&) const = default;
+};
+
+// Hashes of every object under a root, computed in a single pass. Equal objects have equal
+// hashes, so comparing hashes skips over identical subtrees in O(1). The hashes are invalidated
+// by modifying the tree.
+// Subtrees are hashed in parallel if threads != 1, where 0 means one per hardware thread.
+class ObjectHashes {
+public:
+  ObjectHashes(ConstObject root, std::size_t threads = 1);
+
+  // The object must be the root or one of its descendents
+  ObjectHash operator()(ConstObject object) const;
+
+private:
+  void hash_subtree(int root);
+  void hash_node(int node);
+
+  std::shared_ptr<const Tree> tree;
+  std::vector<ObjectHash> hashes;
+};
 #if 0
 bool operator==(ConstObject lhs, const primitive_t& rhs);
 #endif
@@ -740,7 +1155,14 @@ using Object_ = object::Object_<Const>;
 using Object = Object_<false>;
 using ConstObject = Object_<true>;
 
-void object_prune(Object object);
+// The functions below take an optional number of threads. If this isn't 1, they split the
+// objects into subtrees which are processed in parallel, for very large objects. 0 means one
+// thread per hardware thread. The results are the same regardless of the number of threads.
+
+void object_prune(Object object, std::size_t threads = 1);
+
+// Equivalent to lhs == rhs
+bool object_equal(ConstObject lhs, ConstObject rhs, std::size_t threads = 1);
 
 /* @brief Merges the object "diff" on top of "base"
  *
@@ -755,7 +1177,19 @@ void object_prune(Object object);
  * @param diff The object applied on top
  * @return The merged object
  */
-Object object_merge(ConstObject base, ConstObject diff);
+Object object_merge(ConstObject base, ConstObject diff, std::size_t threads = 1);
+
+/* @brief Merges the object "diff" into "base", in place
+ *
+ * Equivalent to base = object_merge(base, diff), but only modifies the parts of base that
+ * the diff changes, so only these are pruned: null values and empty maps elsewhere in base
+ * are kept. If base is a root object, the tree may be compacted afterwards, which
+ * invalidates handles to its other nodes (see Object::compact()).
+ *
+ * @param base The base object, which is modified
+ * @param diff The object applied on top
+ */
+void object_merge_into(Object base, ConstObject diff, std::size_t threads = 1);
 
 /* @brief Finds the difference between the objects "base" and "modified"
  *
@@ -767,7 +1201,7 @@ Object object_merge(ConstObject base, ConstObject diff);
  * @param modified The modified object to compare base to
  * @return The diff object that when applied on top of base, returns modified
  */
-Object object_diff(ConstObject base, ConstObject modified);
+Object object_diff(ConstObject base, ConstObject modified, std::size_t threads = 1);
 
 class ObjectWriter : public Writer {
 public:
@@ -820,7 +1254,7 @@ public:
 
   void object_begin() override;
   void object_end() override;
-  void object_next(const char* key) override;
+  bool object_next(const char* key) override;
 
   void tuple_begin() override;
   void tuple_end() override;
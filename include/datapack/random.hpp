@@ -25,7 +25,9 @@ public:
 
   void object_begin() override {}
   void object_end() override {}
-  void object_next(const char* key) override {}
+  bool object_next(const char* key) override {
+    return true;
+  }
 
   void tuple_begin() override {}
   void tuple_end() override {}
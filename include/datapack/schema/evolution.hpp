@@ -0,0 +1,78 @@
+#pragma once
+
+#include "datapack/binary.hpp"
+#include "datapack/schema/schema.hpp"
+#include <optional>
+
+namespace dpack {
+
+// Reads binary data written with an earlier version of a type into the current version, using
+// the schema the data was written with. Object members are matched by key, so members can be
+// added, removed or reordered: added members keep their default value and removed members are
+// skipped. Numbers are converted if their type changed, values can become optional, and
+// enumerate and variant labels are matched by name. Any other change invalidates the reader.
+// Only the Fixed binary format is supported. The schema and data must outlive the reader.
+class SchemaEvolutionReader final : public Reader {
+public:
+  SchemaEvolutionReader(const Schema& schema, const std::span<const std::uint8_t>& data);
+
+  void number(NumberType type, void* value) override;
+  bool boolean() override;
+  const char* string() override;
+  int enumerate(const std::span<const char*>& labels) override;
+  std::span<const std::uint8_t> binary() override;
+
+  bool optional_begin() override;
+  void optional_end() override {}
+
+  int variant_begin(const std::span<const char*>& labels) override;
+  void variant_end() override {}
+
+  void object_begin() override;
+  bool object_next(const char* key) override;
+  void object_end() override;
+
+  void tuple_begin() override;
+  void tuple_next() override;
+  void tuple_end() override;
+
+  size_t list_begin() override;
+  void list_next() override;
+  void list_end() override;
+
+  void list_numbers(NumberType type, void* data, std::size_t size) override;
+  const void* borrow_numbers(NumberType type, std::size_t size) override;
+
+private:
+  using Program = Schema::Program;
+
+  enum class FrameType { Object, Tuple, List, Missing };
+  struct Frame {
+    FrameType type;
+    std::uint32_t token;         // Object or tuple: the next member. List: the element.
+    std::uint32_t begin_token;   // Object: the first member
+    std::size_t begin = 0;       // Object: position of the first member
+    std::size_t end = 0;         // Object: position after the last member, once indexed
+    bool member_missing = false; // The member being read isn't in the data
+    // Object: position of each member, if they are read in a different order to the data
+    std::vector<std::pair<std::uint32_t, std::size_t>> members;
+  };
+
+  bool skipping();
+  bool same_numbers(NumberType type);
+  void skip(std::uint32_t token);
+  void skip_members(std::uint32_t begin, std::uint32_t end);
+  void index_members(Frame& frame);
+  std::uint32_t value_token(std::uint32_t token) const;
+  std::size_t pos() const;
+  void seek(std::size_t pos);
+
+  const Program* program;
+  std::span<const std::uint8_t> data;
+  std::optional<BinaryReader> reader; // Replaced to seek
+  std::size_t reader_begin;
+  std::uint32_t token; // The value being read
+  std::vector<Frame> frames;
+};
+
+} // namespace dpack
@@ -3,6 +3,7 @@
 #include "datapack/datapack.hpp"
 #include "datapack/schema/token.hpp"
 #include "datapack/schema/tokenizer.hpp"
+#include <memory>
 #include <stdexcept>
 
 namespace dpack {
@@ -14,6 +15,8 @@ public:
 
 class Schema {
 public:
+  // Converts a value from reader to writer. The schema is compiled when it is created, so this
+  // doesn't interpret the tokens, and any error in their structure is thrown here.
   void apply(Reader& reader, Writer& writer) const;
   void apply(Reader&& reader, Writer&& writer) const {
     apply(reader, writer);
@@ -95,7 +98,8 @@ public:
     // Next immediate token
     Iterator next() const;
 
-    // Skips to next token at the same depth
+    // Skips to next token at the same depth. Uses a table built with the schema, so takes
+    // constant time.
     Iterator skip() const;
 
     friend bool operator==(const Iterator& lhs, const Iterator& rhs) {
@@ -123,14 +127,14 @@ public:
     T dummy;
     Schema result;
     Tokenizer(result.tokens).value(dummy);
-    result.set_hash();
+    result.update();
     return result;
   }
 
   static Schema from_tokens(const std::vector<Token>& tokens) {
     Schema result;
     result.tokens = tokens;
-    result.set_hash();
+    result.update();
     return result;
   }
 
@@ -148,23 +152,36 @@ public:
   DPACK_CLASS_DECL();
 
 private:
+  struct Program;
+
+  // Called after the tokens change, including when a schema is read. The const overload is
+  // called when writing, since the same definition is used for reading and writing.
+  void update();
+  void update() const {}
+
   void set_hash();
 
   std::vector<Token> tokens;
   std::uint64_t hash_ = 0;
+  std::shared_ptr<const Program> program; // Shared between copies
 
   friend bool operator==(const Schema& lhs, const Schema& rhs);
+  friend class SchemaEvolutionReader;
 };
 
+// The schema of a type is made on first use. Function-local statics are initialised exactly
+// once, even if first used from several threads at the same time, and after that only need an
+// atomic load to check, so these can be called from any thread without contention.
+
+template <typename T>
+const Schema& get_schema() {
+  static const Schema schema = Schema::make<T>();
+  return schema;
+}
+
 template <typename T>
 std::uint64_t get_hash() {
-  static std::uint64_t hash = 0;
-  static bool calculated = false;
-  if (!calculated) {
-    calculated = true;
-    hash = Schema::make<T>().hash();
-  }
-  return hash;
+  return get_schema<T>().hash();
 }
 
 } // namespace dpack
@@ -23,7 +23,7 @@ public:
   void variant_end() override;
 
   void object_begin() override;
-  void object_next(const char* key) override;
+  bool object_next(const char* key) override;
   void object_end() override;
 
   void tuple_begin() override;
@@ -6,27 +6,40 @@
 
 namespace dpack {
 
-template <typename T, std::size_t N>
+template <typename T, std::size_t N, writer_type Packer>
 requires writeable<T>
-void write(Writer& writer, const std::array<T, N>& value) {
+void write(Packer& writer, const std::array<T, N>& value) {
   writer.tuple_begin();
-  for (const auto& element : value) {
-    writer.tuple_next();
-    writer.value(element);
+  if constexpr (numeric<T>) {
+    writer.tuple_numbers(number_type<T>, value.data(), N);
+  } else {
+    for (const auto& element : value) {
+      writer.tuple_next();
+      writer.value(element);
+    }
   }
   writer.tuple_end();
 }
 
-template <typename T, std::size_t N>
+template <typename T, std::size_t N, reader_type Packer>
 requires readable<T>
-void read(Reader& reader, std::array<T, N>& value) {
+void read(Packer& reader, std::array<T, N>& value) {
   reader.tuple_begin();
-  for (auto& element : value) {
-    reader.tuple_next();
-    reader.value(element);
+  if constexpr (numeric<T>) {
+    reader.tuple_numbers(number_type<T>, value.data(), N);
+  } else {
+    for (auto& element : value) {
+      reader.tuple_next();
+      reader.value(element);
+    }
   }
   reader.tuple_end();
   return;
 }
 
+template <typename Query, typename T, std::size_t N>
+constexpr std::size_t fixed_size(Query, const std::array<T, N>*) {
+  return Query::array(Query::template size<T>(), N);
+}
+
 } // namespace dpack
@@ -5,9 +5,9 @@
 
 namespace dpack {
 
-template <typename T>
+template <typename T, writer_type Packer>
 requires writeable<T>
-void write(Writer& writer, const std::optional<T>& value) {
+void write(Packer& writer, const std::optional<T>& value) {
   writer.optional_begin(value.has_value());
   if (value.has_value()) {
     writer.value(value.value());
@@ -15,9 +15,9 @@ void write(Writer& writer, const std::optional<T>& value) {
   }
 }
 
-template <typename T>
+template <typename T, reader_type Packer>
 requires readable<T>
-void read(Reader& reader, std::optional<T>& value) {
+void read(Packer& reader, std::optional<T>& value) {
   if (reader.optional_begin()) {
     value.emplace();
     reader.value(value.value());
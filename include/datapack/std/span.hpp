@@ -0,0 +1,50 @@
+#pragma once
+
+#include "datapack/datapack.hpp"
+#include <span>
+
+namespace dpack {
+
+// Spans refer to data within the source being read from (eg: the BinaryReader buffer), so are
+// only valid while that source is. Streaming readers can't be read from.
+
+template <writer_type Packer>
+void write(Packer& writer, const std::span<const std::uint8_t>& value) {
+  writer.binary(value);
+}
+
+template <reader_type Packer>
+void read(Packer& reader, std::span<const std::uint8_t>& value) {
+  value = reader.borrow_binary();
+}
+
+// Numbers use the same format as std::vector<T>, but can only be read by readers that support
+// borrow_numbers(), and the data must be suitably aligned within the buffer. Otherwise the
+// reader is invalidated.
+
+template <numeric T, writer_type Packer>
+void write(Packer& writer, const std::span<const T>& value) {
+  writer.list_begin(value.size());
+  writer.list_numbers(number_type<T>, value.data(), value.size());
+  writer.list_end();
+}
+
+template <numeric T, reader_type Packer>
+void read(Packer& reader, std::span<const T>& value) {
+  std::size_t size = reader.list_begin();
+  if (reader.is_tokenizer()) {
+    T element;
+    reader.list_numbers(number_type<T>, &element, 1);
+    value = {};
+  } else if (size == 0) {
+    value = {};
+  } else if (auto data = reader.borrow_numbers(number_type<T>, size)) {
+    value = std::span<const T>((const T*)data, size);
+  } else {
+    reader.invalidate();
+    value = {};
+  }
+  reader.list_end();
+}
+
+} // namespace dpack
@@ -5,11 +5,13 @@
 
 namespace dpack {
 
-inline void write(Writer& writer, const std::string& value) {
+template <writer_type Packer>
+void write(Packer& writer, const std::string& value) {
   writer.string(value.c_str());
 }
 
-inline void read(Reader& reader, std::string& value) {
+template <reader_type Packer>
+void read(Packer& reader, std::string& value) {
   if (auto str = reader.string()) {
     value = str;
   } else {
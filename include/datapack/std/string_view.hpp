@@ -0,0 +1,26 @@
+#pragma once
+
+#include "datapack/datapack.hpp"
+#include <string>
+#include <string_view>
+
+namespace dpack {
+
+template <writer_type Packer>
+void write(Packer& writer, const std::string_view& value) {
+  // Writers expect a null-terminated string
+  writer.string(std::string(value).c_str());
+}
+
+// Refers to the string within the source being read from (eg: the BinaryReader buffer),
+// so is only valid while that source is. Streaming readers can't be read from.
+template <reader_type Packer>
+void read(Packer& reader, std::string_view& value) {
+  if (auto str = reader.borrow_string()) {
+    value = str;
+  } else {
+    value = {};
+  }
+}
+
+} // namespace dpack
@@ -5,9 +5,9 @@
 
 namespace dpack {
 
-template <typename K, typename V>
+template <typename K, typename V, writer_type Packer>
 requires writeable<K> && writeable<V>
-void write(Writer& writer, const std::unordered_map<K, V>& map) {
+void write(Packer& writer, const std::unordered_map<K, V>& map) {
   writer.list_begin(map.size());
   for (const auto& [key, value] : map) {
     writer.list_next();
@@ -23,9 +23,9 @@ void write(Writer& writer, const std::unordered_map<K, V>& map) {
   writer.list_end();
 }
 
-template <typename K, typename V>
+template <typename K, typename V, reader_type Packer>
 requires readable<K> && readable<V>
-void read(Reader& reader, std::unordered_map<K, V>& map) {
+void read(Packer& reader, std::unordered_map<K, V>& map) {
   map.clear();
   const size_t size = reader.list_begin();
   for (size_t i = 0; i < size; i++) {
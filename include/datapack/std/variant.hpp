@@ -5,22 +5,22 @@
 
 namespace dpack {
 
-template <labelled_variant T>
-void write(Writer& writer, const T& value) {
+template <labelled_variant T, writer_type Packer>
+void write(Packer& writer, const T& value) {
   writer.variant_begin(value.index(), variant_labels<T>);
   std::visit([&](const auto& value) { writer.value(value); }, value);
   writer.variant_end();
 }
 
-template <labelled_variant T>
-void read_variant_next(Reader& reader, T& value, int value_index, int index) {
+template <reader_type Packer, labelled_variant T>
+void read_variant_next(Packer& reader, T& value, int value_index, int index) {
   if (!reader.is_tokenizer()) {
     reader.invalidate();
   }
 }
 
-template <labelled_variant T, typename Next, typename... Args>
-void read_variant_next(Reader& reader, T& value, int value_index, int index) {
+template <reader_type Packer, labelled_variant T, typename Next, typename... Args>
+void read_variant_next(Packer& reader, T& value, int value_index, int index) {
   if (reader.is_tokenizer()) {
     Next dummy;
     reader.variant_tokenize(index);
@@ -31,15 +31,15 @@ void read_variant_next(Reader& reader, T& value, int value_index, int index) {
     value = next;
     return;
   }
-  read_variant_next<T, Args...>(reader, value, value_index, index + 1);
+  read_variant_next<Packer, T, Args...>(reader, value, value_index, index + 1);
 }
 
-template <typename... Args>
+template <reader_type Packer, typename... Args>
 requires labelled_variant<std::variant<Args...>>
-void read(Reader& reader, std::variant<Args...>& value) {
+void read(Packer& reader, std::variant<Args...>& value) {
   using T = std::variant<Args...>;
   int value_int = reader.variant_begin(variant_labels<T>);
-  read_variant_next<T, Args...>(reader, value, value_int, 0);
+  read_variant_next<Packer, T, Args...>(reader, value, value_int, 0);
   reader.variant_end();
 }
 
@@ -5,24 +5,32 @@
 
 namespace dpack {
 
-template <typename T>
+template <typename T, writer_type Packer>
 requires writeable<T>
-void write(Writer& writer, const std::vector<T>& value) {
+void write(Packer& writer, const std::vector<T>& value) {
   writer.list_begin(value.size());
-  for (const auto& element : value) {
-    writer.list_next();
-    writer.value(element);
+  if constexpr (numeric<T>) {
+    writer.list_numbers(number_type<T>, value.data(), value.size());
+  } else {
+    for (const auto& element : value) {
+      writer.list_next();
+      writer.value(element);
+    }
   }
   writer.list_end();
 }
 
-template <typename T>
+template <typename T, reader_type Packer>
 requires readable<T>
-void read(Reader& reader, std::vector<T>& value) {
+void read(Packer& reader, std::vector<T>& value) {
   value.resize(reader.list_begin());
-  for (size_t i = 0; i < value.size(); i++) {
-    reader.list_next();
-    reader.value(value[i]);
+  if constexpr (numeric<T>) {
+    reader.list_numbers(number_type<T>, value.data(), value.size());
+  } else {
+    for (size_t i = 0; i < value.size(); i++) {
+      reader.list_next();
+      reader.value(value[i]);
+    }
   }
   reader.list_end();
 }
@@ -1,108 +1,94 @@
 #include "datapack/binary.hpp"
+#include <algorithm>
 #include <assert.h>
 #include <cstring>
+#include <istream>
 
 namespace dpack {
 
-void BinaryReader::number(NumberType type, void* value) {
-  switch (type) {
-  case NumberType::I32:
-    value_number(*(std::int32_t*)value);
-    break;
-  case NumberType::I64:
-    value_number(*(std::int64_t*)value);
-    break;
-  case NumberType::U32:
-    value_number(*(std::uint32_t*)value);
-    break;
-  case NumberType::U64:
-    value_number(*(std::uint64_t*)value);
-    break;
-  case NumberType::U8:
-    value_number(*(std::uint8_t*)value);
-    break;
-  case NumberType::F32:
-    value_number(*(float*)value);
-    break;
-  case NumberType::F64:
-    value_number(*(double*)value);
-    break;
-  }
-}
-
-bool BinaryReader::boolean() {
-  return value_bool();
-}
+BinaryReader::BinaryReader(
+    std::istream& is,
+    std::vector<std::uint8_t>& buffer,
+    BinaryFormat format) :
+    BinaryReader(
+        [&is](std::span<std::uint8_t> data) -> std::size_t {
+          is.read((char*)data.data(), data.size());
+          return is.gcount();
+        },
+        buffer,
+        format) {}
 
 const char* BinaryReader::string() {
-  std::size_t max_len = buffer.size() - pos;
-  std::size_t len = strnlen((char*)&buffer[pos], max_len);
-  if (len == max_len) {
-    invalidate();
-    return nullptr;
+  std::size_t len = strnlen((const char*)buffer.data() + pos_, buffer.size() - pos_);
+  // If streaming, keep reading until the null terminator is found
+  while (pos_ + len == buffer.size()) {
+    if (!refill(len + 1)) {
+      invalidate();
+      return nullptr;
+    }
+    len += strnlen((const char*)buffer.data() + pos_ + len, buffer.size() - pos_ - len);
   }
-  const char* result = (char*)&buffer[pos];
-  pos += (len + 1);
+  const char* result = (const char*)buffer.data() + pos_;
+  pos_ += (len + 1);
   return result;
 }
 
-int BinaryReader::enumerate(const std::span<const char*>& labels) {
-  int value = -1;
-  value_number(value);
-  return value;
-}
-
-bool BinaryReader::optional_begin() {
-  return value_bool();
-}
-
-int BinaryReader::variant_begin(const std::span<const char*>& labels) {
-  int value = -1;
-  value_number(value);
-  return value;
-}
-
 std::span<const std::uint8_t> BinaryReader::binary() {
-  std::uint64_t length;
-  value_number(length);
-  if (pos + length > buffer.size()) {
+  std::uint64_t length = value_length();
+  if (!available(length)) {
     invalidate();
-    return std::span(buffer.data() + pos, 0);
+    return std::span(buffer.data() + pos_, 0);
   }
-  auto result = std::span(buffer.data() + pos, length);
-  pos += length;
+  auto result = std::span(buffer.data() + pos_, length);
+  pos_ += length;
   return result;
 }
 
-size_t BinaryReader::list_begin() {
-  std::uint64_t length;
-  value_number(length);
-  return length;
-}
-
-template <typename T>
-void BinaryReader::value_number(T& value) {
-  if (pos + sizeof(T) > buffer.size()) {
-    invalidate();
-    return;
+void BinaryReader::value_bytes_slow(void* data, std::size_t size) {
+  // Copy in pieces if streaming, rather than reading everything into the buffer
+  while (true) {
+    std::size_t count = std::min(size, buffer.size() - pos_);
+    std::memcpy(data, buffer.data() + pos_, count);
+    pos_ += count;
+    data = (std::uint8_t*)data + count;
+    size -= count;
+    if (size == 0) {
+      return;
+    }
+    if (!refill(1)) {
+      invalidate();
+      return;
+    }
   }
-
-  value = *((T*)&buffer[pos]);
-  pos += sizeof(T);
 }
 
-bool BinaryReader::value_bool() {
-  if (pos + 1 > buffer.size()) {
-    invalidate();
+bool BinaryReader::refill(std::size_t size) {
+  if (!read_source) {
     return false;
   }
-  std::uint8_t value_int = *((bool*)&buffer[pos]);
-  if (value_int >= 2) {
-    invalidate();
-    return false;
+  // Move the unread data to the start of the buffer, then fill the rest
+  std::size_t remaining = buffer.size() - pos_;
+  consumed += pos_;
+  if (remaining > 0) {
+    std::memmove(storage->data(), storage->data() + pos_, remaining);
+  }
+  if (storage->size() < size) {
+    static constexpr std::size_t min_size = 4096;
+    storage->resize(std::max({size, 2 * storage->size(), min_size}));
+  }
+  while (remaining < storage->size()) {
+    std::size_t count = read_source(std::span(*storage).subspan(remaining));
+    if (count == 0) {
+      break;
+    }
+    remaining += count;
+    if (remaining >= size) {
+      break;
+    }
   }
-  pos++;
-  return value_int;
+  buffer = std::span(storage->data(), remaining);
+  pos_ = 0;
+  return remaining >= size;
 }
 
 } // namespace dpack
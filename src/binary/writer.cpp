@@ -1,91 +1,72 @@
 #include "datapack/binary.hpp"
+#include <algorithm>
 #include <assert.h>
 #include <cstring>
+#include <ostream>
 #include <stdexcept>
 
 namespace dpack {
 
-void BinaryWriter::number(NumberType type, const void* value) {
-  switch (type) {
-  case NumberType::I32:
-    value_number(*(std::int32_t*)value);
-    break;
-  case NumberType::I64:
-    value_number(*(std::int64_t*)value);
-    break;
-  case NumberType::U32:
-    value_number(*(std::uint32_t*)value);
-    break;
-  case NumberType::U64:
-    value_number(*(std::uint64_t*)value);
-    break;
-  case NumberType::U8:
-    value_number(*(std::uint8_t*)value);
-    break;
-  case NumberType::F32:
-    value_number(*(float*)value);
-    break;
-  case NumberType::F64:
-    value_number(*(double*)value);
-    break;
-  }
-}
-
-void BinaryWriter::boolean(bool value) {
-  value_bool(value);
-}
+BinaryWriter::BinaryWriter(std::ostream& os, std::span<std::uint8_t> buffer, BinaryFormat format) :
+    BinaryWriter(
+        [&os](std::span<const std::uint8_t> data) {
+          os.write((const char*)data.data(), data.size());
+        },
+        buffer,
+        format) {}
 
 void BinaryWriter::string(const char* value) {
-  std::size_t size = std::strlen(value) + 1;
-  if (pos_ + size > buffer.size()) {
-    throw std::runtime_error("Writer buffer is too small");
-  }
-  strncpy((char*)&buffer[pos_], value, size);
-  pos_ += size;
+  value_bytes(value, std::strlen(value) + 1);
 }
 
-void BinaryWriter::enumerate(int value, const std::span<const char*>& labels) {
-  value_number(value);
-}
-
-void BinaryWriter::optional_begin(bool has_value) {
-  value_bool(has_value);
+void BinaryWriter::binary(const std::span<const std::uint8_t>& data) {
+  value_length(data.size());
+  value_bytes(data.data(), data.size());
 }
 
-void BinaryWriter::variant_begin(int value, const std::span<const char*>& labels) {
-  value_number(value);
+void BinaryWriter::value_bytes_slow(const void* data, std::size_t size) {
+  if (flush_buffer && size > buffer.size()) {
+    // Too large to buffer, so pass straight to the sink
+    flush();
+    flush_buffer(std::span((const std::uint8_t*)data, size));
+    flushed += size;
+    return;
+  }
+  reserve(size);
+  std::memcpy(&buffer[pos_], data, size);
+  pos_ += size;
 }
 
-void BinaryWriter::binary(const std::span<const std::uint8_t>& data) {
-  value_number(std::uint64_t(data.size()));
-  if (pos_ + data.size() > buffer.size()) {
+void BinaryWriter::grow(std::size_t size) {
+  if (flush_buffer) {
+    flush();
+    if (size > buffer.size()) {
+      throw std::runtime_error("Writer buffer is too small");
+    }
+    return;
+  }
+  if (!resize_buffer) {
     throw std::runtime_error("Writer buffer is too small");
   }
-  std::memcpy(&buffer[pos_], data.data(), data.size());
-  pos_ += data.size();
+  static constexpr std::size_t min_size = 64;
+  buffer = resize_buffer(std::max({2 * buffer.size(), pos_ + size, min_size}));
 }
 
-void BinaryWriter::list_begin(size_t size) {
-  value_number(size);
-}
-
-// Note: Fine to put implementation in source file here, since all usage of the
-// method occurs in the same source file
-template <typename T>
-void BinaryWriter::value_number(T value) {
-  if (pos_ + sizeof(T) > buffer.size()) {
-    throw std::runtime_error("Writer buffer is too small");
+void BinaryWriter::flush() {
+  if (pos_ > 0) {
+    flush_buffer(buffer.subspan(0, pos_));
+    flushed += pos_;
+    pos_ = 0;
   }
-  *((T*)&buffer[pos_]) = value;
-  pos_ += sizeof(T);
 }
 
-void BinaryWriter::value_bool(bool value) {
-  if (pos_ + 1 > buffer.size()) {
-    throw std::runtime_error("Writer buffer is too small");
+void BinaryWriter::finish() {
+  if (resize_buffer) {
+    buffer = resize_buffer(pos_);
+  }
+  if (flush_buffer) {
+    flush();
   }
-  buffer[pos_] = (value ? 0x01 : 0x00);
-  pos_++;
 }
 
 } // namespace dpack
@@ -1,11 +1,38 @@
 #include "datapack/file.hpp"
+#include <algorithm>
 #include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace dpack {
 
-static const char* SPECIAL = "DATAPACK";
+// Files written before chunk data was aligned start with LEGACY_SPECIAL, and are still read
+static const char* SPECIAL = "DATAPAK2";
+static const char* LEGACY_SPECIAL = "DATAPACK";
+static constexpr std::size_t buffer_size = 64 * 1024;
+// Set in the label size of chunks holding the schema of the label's values. Any hash is valid,
+// so chunks can't be marked by their hash instead.
+static constexpr std::uint32_t schema_chunk_flag = std::uint32_t(1) << 31;
+// Chunk data is padded to start at a multiple of this (relative to the start of the file, so
+// also within a mapping of it), so numbers can be borrowed from the mapping in place
+static constexpr std::size_t chunk_alignment = 8;
 
-FileWriter::FileWriter(const std::string& path) : os(path, std::ios_base::binary) {
+// Returns the chunk data alignment for the file format, or zero if it isn't a datapack file
+static std::size_t format_alignment(const char* special) {
+  if (std::memcmp(special, SPECIAL, 8) == 0) {
+    return chunk_alignment;
+  }
+  if (std::memcmp(special, LEGACY_SPECIAL, 8) == 0) {
+    return 1;
+  }
+  return 0;
+}
+
+FileWriter::FileWriter(const std::string& path, bool embed_schemas) :
+    os(path, std::ios_base::binary), embed_schemas(embed_schemas), buffer(buffer_size) {
   os << SPECIAL;
 }
 
@@ -15,37 +42,62 @@ void FileWriter::close() {
   }
 }
 
-void FileWriter::check_hash(const std::string& label, std::uint64_t hash) {
+bool FileWriter::check_hash(const std::string& label, std::uint64_t hash) {
   auto iter = label_hashes.find(label);
   if (iter == label_hashes.end()) {
     label_hashes.emplace(label, hash);
-  } else if (iter->second != hash) {
+    return true;
+  }
+  if (iter->second != hash) {
     throw TypeError();
   }
+  return false;
 }
 
-void FileWriter::write_chunk(
-    const std::string& label,
-    std::uint64_t hash,
-    const std::vector<std::uint8_t>& data) {
+void FileWriter::write_schema(const std::string& label, const Schema& schema) {
+  begin_chunk(label, schema.hash(), true);
+  BinaryWriter writer(os, buffer);
+  writer.value(schema);
+  writer.finish();
+  end_chunk(writer.pos());
+}
+
+void FileWriter::begin_chunk(const std::string& label, std::uint64_t hash, bool schema_chunk) {
   // Write label
-  std::uint32_t label_size = label.size();
+  if (label.size() >= schema_chunk_flag) {
+    throw std::length_error("Label is too long");
+  }
+  std::uint32_t label_size = label.size() | (schema_chunk ? schema_chunk_flag : 0);
   os.write((const char*)&label_size, sizeof(label_size));
   os.write(label.data(), label.size());
 
   // Write hash
   os.write((const char*)&hash, sizeof(hash));
 
-  // Write data
-  std::uint64_t data_size = data.size();
+  // Data size isn't known until the data is written, so leave space for it
+  data_size_pos = os.tellp();
+  std::uint64_t data_size = 0;
   os.write((const char*)&data_size, sizeof(data_size));
-  os.write((const char*)data.data(), data.size());
+
+  static const char padding[chunk_alignment] = {};
+  os.write(padding, align_padding(os.tellp(), chunk_alignment));
+}
+
+void FileWriter::end_chunk(std::uint64_t data_size) {
+  std::streampos end_pos = os.tellp();
+  os.seekp(data_size_pos);
+  os.write((const char*)&data_size, sizeof(data_size));
+  os.seekp(end_pos);
 }
 
-FileReader::FileReader(const std::string& path) : is(path, std::ios_base::binary) {
-  std::string special_buff = SPECIAL;
-  is.read(special_buff.data(), 8);
-  if (special_buff != SPECIAL) {
+FileReader::FileReader(const std::string& path) :
+    is(path, std::ios_base::binary), current_hash(0), chunk_remaining(0), alignment(0) {
+  char special[8];
+  if (!is.read(special, 8)) {
+    throw FileError();
+  }
+  alignment = format_alignment(special);
+  if (alignment == 0) {
     throw FileError();
   }
 }
@@ -57,64 +109,264 @@ void FileReader::close() {
 }
 
 std::optional<std::string> FileReader::next() {
-  is.peek(); // Required to check for eof
-  if (is.eof()) {
-    return std::nullopt;
+  while (true) {
+    is.peek(); // Required to check for eof
+    if (is.eof()) {
+      return std::nullopt;
+    }
+    std::uint32_t label_size;
+    if (!is.read((char*)&label_size, sizeof(label_size))) {
+      throw FileError();
+    }
+    const bool schema_chunk = label_size & schema_chunk_flag;
+    current_label.resize(label_size & ~schema_chunk_flag);
+    if (!is.read(current_label.data(), current_label.size())) {
+      throw FileError();
+    }
+    if (!is.read((char*)&current_hash, sizeof(current_hash))) {
+      throw FileError();
+    }
+    if (!is.read((char*)&chunk_remaining, sizeof(chunk_remaining))) {
+      throw FileError();
+    }
+    if (!is.seekg(align_padding(is.tellg(), alignment), std::ios::cur)) {
+      throw FileError();
+    }
+
+    if (schema_chunk) {
+      Schema schema;
+      BinaryReader reader = chunk_reader();
+      reader.value(schema);
+      end_chunk(reader);
+      label_schemas[current_label] = std::move(schema);
+      continue;
+    }
+
+    auto iter = label_hashes.find(current_label);
+    if (iter == label_hashes.end()) {
+      label_hashes.emplace(current_label, current_hash);
+    } else if (iter->second != current_hash) {
+      // Inconsistent hash for this label
+      throw FileError();
+    }
+    return current_label;
   }
-  std::uint32_t label_size;
-  if (!is.read((char*)&label_size, sizeof(label_size))) {
-    throw FileError();
+}
+
+bool FileReader::current_matches(const Schema& schema) const {
+  if (current_hash != schema.hash()) {
+    return false;
   }
-  current_label.resize(label_size);
-  if (!is.read(current_label.data(), current_label.size())) {
-    throw FileError();
+  auto iter = label_schemas.find(current_label);
+  return iter == label_schemas.end() || iter->second == schema;
+}
+
+void FileReader::check_schema(const Schema& schema) const {
+  if (!current_matches(schema)) {
+    throw TypeError();
   }
-  return current_label;
 }
 
-void FileReader::check_hash(
-    std::uint64_t stored_hash,
-    const std::string& label,
-    std::uint64_t expected_hash) {
-  if (stored_hash != expected_hash) {
+const Schema& FileReader::current_schema() {
+  auto iter = label_schemas.find(current_label);
+  if (iter == label_schemas.end() || iter->second.hash() != current_hash) {
     throw TypeError();
   }
-  auto iter = label_hashes.find(current_label);
-  if (iter == label_hashes.end()) {
-    label_hashes.emplace(current_label, stored_hash);
-  } else if (iter->second != stored_hash) {
-    // Inconsistent hash for this label
-    throw FileError();
+  return iter->second;
+}
+
+BinaryReader FileReader::chunk_reader() {
+  if (buffer.size() < buffer_size) {
+    buffer.resize(buffer_size);
+  }
+  // Chunks that fit in the buffer are read whole, so borrowed values can be read from them
+  if (chunk_remaining <= buffer.size()) {
+    if (!is.read((char*)buffer.data(), chunk_remaining)) {
+      throw FileError();
+    }
+    auto data = std::span<const std::uint8_t>(buffer.data(), chunk_remaining);
+    chunk_remaining = 0;
+    return BinaryReader(data);
   }
+  // Only read up to the end of the current chunk
+  auto source = [this](std::span<std::uint8_t> data) -> std::size_t {
+    std::size_t size = std::min<std::uint64_t>(data.size(), chunk_remaining);
+    is.read((char*)data.data(), size);
+    chunk_remaining -= is.gcount();
+    return is.gcount();
+  };
+  return BinaryReader(source, buffer);
 }
 
-std::tuple<std::uint64_t, std::vector<std::uint8_t>> FileReader::read_chunk_remainder() {
-  std::uint64_t hash;
-  if (!is.read((char*)&hash, sizeof(hash))) {
+std::span<const std::uint8_t> FileReader::read_chunk_data() {
+  buffer.resize(chunk_remaining);
+  if (!is.read((char*)buffer.data(), buffer.size())) {
     throw FileError();
   }
-  std::uint64_t data_size;
-  if (!is.read((char*)&data_size, sizeof(data_size))) {
+  chunk_remaining = 0;
+  return buffer;
+}
+
+void FileReader::end_chunk(const BinaryReader& reader) {
+  if (!reader.valid()) {
     throw FileError();
   }
-  std::vector<std::uint8_t> data(data_size);
-  if (!is.read((char*)data.data(), data.size())) {
+  // Skip anything that wasn't read
+  if (!is.seekg(chunk_remaining, std::ios::cur)) {
     throw FileError();
   }
-  return std::make_tuple(hash, data);
+  chunk_remaining = 0;
 }
 
 void FileReader::skip() {
-  if (!is.seekg(sizeof(std::uint64_t), std::ios::cur)) {
+  if (!is.seekg(chunk_remaining, std::ios::cur)) {
+    throw FileError();
+  }
+  chunk_remaining = 0;
+}
+
+MappedFileReader::MappedFileReader(const std::string& path) :
+    data(nullptr), size(0), alignment(0) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
     throw FileError();
   }
-  std::uint64_t data_size;
-  if (!is.read((char*)&data_size, sizeof(data_size))) {
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size < 8) {
+    ::close(fd);
     throw FileError();
   }
-  if (!is.seekg(data_size, std::ios::cur)) {
+  void* mapped = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    throw FileError();
+  }
+  data = (const std::uint8_t*)mapped;
+  size = st.st_size;
+
+  try {
+    build_index();
+  } catch (...) {
+    close();
+    throw;
+  }
+}
+
+MappedFileReader::~MappedFileReader() {
+  close();
+}
+
+void MappedFileReader::close() {
+  if (data) {
+    ::munmap((void*)data, size);
+    data = nullptr;
+    size = 0;
+  }
+  index.clear();
+  label_order.clear();
+}
+
+void MappedFileReader::build_index() {
+  alignment = format_alignment((const char*)data);
+  if (alignment == 0) {
+    throw FileError();
+  }
+  std::size_t pos = 8;
+  auto read_header = [&](void* value, std::size_t value_size) {
+    if (value_size > size - pos) {
+      throw FileError();
+    }
+    std::memcpy(value, data + pos, value_size);
+    pos += value_size;
+  };
+
+  while (pos < size) {
+    std::uint32_t label_size;
+    read_header(&label_size, sizeof(label_size));
+    const bool schema_chunk = label_size & schema_chunk_flag;
+    std::string label(label_size & ~schema_chunk_flag, '\0');
+    read_header(label.data(), label.size());
+    Chunk chunk;
+    read_header(&chunk.hash, sizeof(chunk.hash));
+    std::uint64_t data_size;
+    read_header(&data_size, sizeof(data_size));
+    const std::size_t padding = align_padding(pos, alignment);
+    if (padding > size - pos) {
+      throw FileError();
+    }
+    pos += padding;
+    if (data_size > size - pos) {
+      throw FileError();
+    }
+    chunk.begin = pos;
+    chunk.size = data_size;
+    pos += data_size;
+
+    auto iter = index.find(label);
+    if (iter == index.end()) {
+      iter = index.emplace(label, LabelIndex()).first;
+      label_order.push_back(label);
+    }
+    LabelIndex& label_index = iter->second;
+
+    if (schema_chunk) {
+      Schema schema;
+      BinaryReader reader(chunk_data(chunk));
+      reader.value(schema);
+      if (!reader.valid()) {
+        throw FileError();
+      }
+      label_index.schema = std::move(schema);
+      continue;
+    }
+    if (!label_index.chunks.empty() && label_index.chunks.front().hash != chunk.hash) {
+      // Inconsistent hash for this label
+      throw FileError();
+    }
+    label_index.chunks.push_back(chunk);
+  }
+}
+
+std::size_t MappedFileReader::count(const std::string& label) const {
+  auto iter = index.find(label);
+  if (iter == index.end()) {
+    return 0;
+  }
+  return iter->second.chunks.size();
+}
+
+const MappedFileReader::Chunk& MappedFileReader::find_chunk(
+    const std::string& label,
+    std::size_t index) const {
+  if (!data) {
     throw FileError();
   }
+  auto iter = this->index.find(label);
+  if (iter == this->index.end() || index >= iter->second.chunks.size()) {
+    throw std::out_of_range("No value with label '" + label + "'");
+  }
+  return iter->second.chunks[index];
+}
+
+bool MappedFileReader::chunk_matches(
+    const std::string& label,
+    const Chunk& chunk,
+    const Schema& schema) const {
+  if (chunk.hash != schema.hash()) {
+    return false;
+  }
+  const auto& written = index.at(label).schema;
+  return !written || *written == schema;
+}
+
+const Schema& MappedFileReader::label_schema(const std::string& label, std::uint64_t hash)
+    const {
+  const auto& schema = index.at(label).schema;
+  if (!schema || schema->hash() != hash) {
+    throw TypeError();
+  }
+  return *schema;
 }
 
 } // namespace dpack
@@ -1,7 +1,9 @@
 #include "datapack/json.hpp"
 #include "datapack/encode/base64.hpp"
 #include "datapack/encode/floating_string.hpp"
+#include "json/scan.hpp"
 #include <assert.h>
+#include <charconv>
 #include <fstream>
 #include <sstream>
 
@@ -24,6 +26,7 @@ Object load_json(const std::string& json) {
   while (true) {
     int& state = states.top();
 
+    pos = json_skip_whitespace(json, pos);
     if (pos == json.size()) {
       if (!(state & EXPECT_END) || (state & IS_OBJECT) || (state & IS_ARRAY)) {
         throw JsonLoadError("Not expecting the document end");
@@ -34,42 +37,23 @@ Object load_json(const std::string& json) {
     }
 
     const char c = json[pos];
-    if (std::isspace(c)) {
-      pos++;
-      continue;
-    }
     assert(ptr);
 
     if (c == '"' && (state & IS_OBJECT) && (state & EXPECT_ELEMENT)) {
       pos++;
       std::size_t begin = pos;
-      while (true) {
-        if (pos == json.size()) {
-          throw JsonLoadError("Key missing terminating '\"'");
-        }
-        const char c = json[pos];
-        if (c == '"') {
-          break;
-        }
-        pos++;
+      pos = json_find_quote(json, pos);
+      if (pos == json.size()) {
+        throw JsonLoadError("Key missing terminating '\"'");
       }
       std::size_t end = pos;
       pos++;
 
-      while (true) {
-        if (pos == json.size()) {
-          throw JsonLoadError("Expected ':' following key");
-        }
-        const char c = json[pos];
-        pos++;
-        if (std::isspace(c)) {
-          continue;
-        }
-        if (c == ':') {
-          break;
-        }
+      pos = json_skip_whitespace(json, pos);
+      if (pos == json.size() || json[pos] != ':') {
         throw JsonLoadError("Expected ':' following key");
       }
+      pos++;
       state &= ~EXPECT_ELEMENT;
       state |= EXPECT_VALUE;
       std::string key = json.substr(begin, end - begin);
@@ -149,14 +133,9 @@ Object load_json(const std::string& json) {
     if (c == '"') {
       pos++;
       std::size_t begin = pos;
-      while (true) {
-        if (pos == json.size()) {
-          throw JsonLoadError("String missing terminating '\"'");
-        }
-        if (json[pos] == '"') {
-          break;
-        }
-        pos++;
+      pos = json_find_quote(json, pos);
+      if (pos == json.size()) {
+        throw JsonLoadError("String missing terminating '\"'");
       }
       std::size_t end = pos;
       pos++;
@@ -166,19 +145,8 @@ Object load_json(const std::string& json) {
     }
 
     std::size_t begin = pos;
-    while (true) {
-      if (pos == json.size()) {
-        break;
-      }
-      const char c = json[pos];
-      if (std::isspace(c) || c == ',' || c == '}' || c == ']') {
-        break;
-      }
-      pos++;
-    }
-    std::size_t end = pos;
-
-    std::string value = json.substr(begin, end - begin);
+    pos = json_find_value_end(json, pos);
+    std::string_view value(json.data() + begin, pos - begin);
     if (value == "true") {
       *ptr = true;
       ptr = ptr.parent();
@@ -194,13 +162,12 @@ Object load_json(const std::string& json) {
       ptr = ptr.parent();
       continue;
     }
-    try {
-      object::number_t result = std::strtod(value.c_str(), nullptr);
+    object::number_t result;
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+    if (ec == std::errc() && end == value.data() + value.size()) {
       *ptr = result;
       ptr = ptr.parent();
       continue;
-    } catch (std::invalid_argument) {
-    } catch (std::out_of_range) {
     }
 
     throw JsonLoadError("Invalid value '" + std::string(value) + "'");
@@ -309,4 +276,41 @@ void dump_json_file(ConstObject object, const std::string& file) {
   os << dump_json(object);
 }
 
+std::string binary_to_json(
+    const Schema& schema,
+    const std::span<const std::uint8_t>& data,
+    bool pretty) {
+  std::string json;
+  BinaryReader reader(data);
+  JsonWriter writer(json, pretty);
+  schema.apply(reader, writer);
+  if (!reader.valid()) {
+    throw SchemaError("Binary data doesn't match the schema");
+  }
+  return json;
+}
+
+void binary_to_json(const Schema& schema, std::istream& is, std::ostream& os, bool pretty) {
+  std::vector<std::uint8_t> buffer(64 * 1024);
+  BinaryReader reader(is, buffer);
+  JsonWriter writer(os, pretty);
+  schema.apply(reader, writer);
+  writer.finish();
+  if (!reader.valid()) {
+    throw SchemaError("Binary data doesn't match the schema");
+  }
+}
+
+std::vector<std::uint8_t> json_to_binary(const Schema& schema, const std::string& json) {
+  std::vector<std::uint8_t> data;
+  JsonReader reader(json);
+  BinaryWriter writer(data);
+  schema.apply(reader, writer);
+  writer.finish();
+  if (!reader.valid()) {
+    throw SchemaError("JSON doesn't match the schema");
+  }
+  return data;
+}
+
 } // namespace dpack
@@ -0,0 +1,346 @@
+#include "datapack/encode/base64.hpp"
+#include "datapack/json.hpp"
+#include "scan.hpp"
+#include <charconv>
+#include <cstring>
+
+namespace dpack {
+
+JsonReader::JsonReader(const std::string& json) : json(json), pos(0), missing_depth(0) {}
+
+void JsonReader::number(NumberType type, void* value_out) {
+  if (missing_depth) {
+    return;
+  }
+  peek();
+  const char* begin = json.data() + pos;
+  const char* end = json.data() + json_find_value_end(json, pos);
+  double value;
+  auto [ptr, ec] = std::from_chars(begin, end, value);
+  if (ec != std::errc() || ptr != end) {
+    invalidate();
+    skip_value();
+    return;
+  }
+  pos += end - begin;
+
+  switch (type) {
+  case NumberType::I32:
+    *(std::int32_t*)value_out = value;
+    break;
+  case NumberType::I64:
+    *(std::int64_t*)value_out = value;
+    break;
+  case NumberType::U32:
+    *(std::uint32_t*)value_out = value;
+    break;
+  case NumberType::U64:
+    *(std::uint64_t*)value_out = value;
+    break;
+  case NumberType::U8:
+    *(std::uint8_t*)value_out = value;
+    break;
+  case NumberType::F32:
+    *(float*)value_out = value;
+    break;
+  case NumberType::F64:
+    *(double*)value_out = value;
+    break;
+  }
+}
+
+bool JsonReader::boolean() {
+  if (missing_depth) {
+    return false;
+  }
+  if (consume_literal("true")) {
+    return true;
+  }
+  if (consume_literal("false")) {
+    return false;
+  }
+  invalidate();
+  skip_value();
+  return false;
+}
+
+const char* JsonReader::string() {
+  if (missing_depth) {
+    return nullptr;
+  }
+  if (peek() != '"') {
+    invalidate();
+    skip_value();
+    return nullptr;
+  }
+  string_temp = parse_string();
+  return string_temp.c_str();
+}
+
+int JsonReader::enumerate(const std::span<const char*>& labels) {
+  if (missing_depth) {
+    return 0;
+  }
+  if (peek() != '"') {
+    invalidate();
+    skip_value();
+    return 0;
+  }
+  std::string_view value = parse_string();
+  for (std::size_t i = 0; i < labels.size(); i++) {
+    if (value == labels[i]) {
+      return i;
+    }
+  }
+  invalidate();
+  return 0;
+}
+
+std::span<const std::uint8_t> JsonReader::binary() {
+  if (missing_depth) {
+    return std::span<const std::uint8_t>((const std::uint8_t*)nullptr, 0);
+  }
+  if (peek() != '"') {
+    invalidate();
+    skip_value();
+    return std::span<const std::uint8_t>((const std::uint8_t*)nullptr, 0);
+  }
+  data_temp = base64_decode(std::string(parse_string()));
+  return data_temp;
+}
+
+bool JsonReader::optional_begin() {
+  if (missing_depth) {
+    return false;
+  }
+  return !consume_literal("null");
+}
+
+void JsonReader::optional_end() {
+  // Do nothing
+}
+
+int JsonReader::variant_begin(const std::span<const char*>& labels) {
+  object_begin();
+  object_next("type");
+  if (missing_depth) {
+    return 0;
+  }
+  if (peek() == '"') {
+    std::string_view label = parse_string();
+    for (std::size_t i = 0; i < labels.size(); i++) {
+      if (label == labels[i]) {
+        std::string value_key = "value_" + std::string(labels[i]);
+        object_next(value_key.c_str());
+        return i;
+      }
+    }
+  }
+  // Skip reading the value
+  invalidate();
+  missing_depth = objects.size();
+  return 0;
+}
+
+void JsonReader::variant_end() {
+  object_end();
+}
+
+void JsonReader::object_begin() {
+  if (!missing_depth) {
+    expect('{');
+  }
+  objects.push_back(pos);
+}
+
+void JsonReader::object_end() {
+  if (missing_depth) {
+    if (objects.size() > missing_depth) {
+      objects.pop_back();
+      return;
+    }
+    missing_depth = 0;
+  }
+  // Skip any remaining members. Members are always read completely, so the position is
+  // either at the start of the object or following a member.
+  while (!consume('}')) {
+    consume(',');
+    parse_string();
+    expect(':');
+    skip_value();
+  }
+  objects.pop_back();
+}
+
+bool JsonReader::object_next(const char* key) {
+  if (missing_depth) {
+    if (objects.size() > missing_depth) {
+      return true;
+    }
+    missing_depth = 0;
+  }
+  if (objects.empty()) {
+    invalidate();
+    return false;
+  }
+
+  // Fast path: keys are usually in the same order they are read
+  std::size_t next = pos;
+  consume(',');
+  if (peek() == '"' && parse_string() == key) {
+    expect(':');
+    return true;
+  }
+
+  // Otherwise search the whole object
+  pos = objects.back();
+  if (find_key(key)) {
+    return true;
+  }
+  // Skip reading the value, continuing from the next key
+  invalidate();
+  pos = next;
+  missing_depth = objects.size();
+  return false;
+}
+
+void JsonReader::tuple_begin() {
+  if (!missing_depth) {
+    expect('[');
+  }
+}
+
+void JsonReader::tuple_end() {
+  if (!missing_depth) {
+    expect(']');
+  }
+}
+
+void JsonReader::tuple_next() {
+  if (!missing_depth) {
+    consume(',');
+  }
+}
+
+size_t JsonReader::list_begin() {
+  if (missing_depth) {
+    return 0;
+  }
+  expect('[');
+
+  // Count the elements, then go back to the start
+  std::size_t begin = pos;
+  std::size_t size = 0;
+  if (!consume(']')) {
+    do {
+      skip_value();
+      size++;
+    } while (consume(','));
+    expect(']');
+  }
+  pos = begin;
+  return size;
+}
+
+void JsonReader::list_next() {
+  if (!missing_depth) {
+    consume(',');
+  }
+}
+
+void JsonReader::list_end() {
+  if (!missing_depth) {
+    expect(']');
+  }
+}
+
+char JsonReader::peek() {
+  pos = json_skip_whitespace(json, pos);
+  if (pos == json.size()) {
+    return '\0';
+  }
+  return json[pos];
+}
+
+void JsonReader::expect(char c) {
+  if (!consume(c)) {
+    throw JsonLoadError("Expected '" + std::string(1, c) + "'");
+  }
+}
+
+bool JsonReader::consume(char c) {
+  if (peek() != c) {
+    return false;
+  }
+  pos++;
+  return true;
+}
+
+bool JsonReader::consume_literal(const char* literal) {
+  peek();
+  std::size_t size = std::strlen(literal);
+  if (json.substr(pos, size) != literal) {
+    return false;
+  }
+  pos += size;
+  return true;
+}
+
+std::string_view JsonReader::parse_string() {
+  expect('"');
+  std::size_t begin = pos;
+  std::size_t end = json_find_quote(json, pos);
+  if (end == json.size()) {
+    throw JsonLoadError("String missing terminating '\"'");
+  }
+  pos = end + 1;
+  return json.substr(begin, end - begin);
+}
+
+bool JsonReader::find_key(const char* key) {
+  while (!consume('}')) {
+    consume(',');
+    bool found = parse_string() == key;
+    expect(':');
+    if (found) {
+      return true;
+    }
+    skip_value();
+  }
+  return false;
+}
+
+void JsonReader::skip_value() {
+  const char c = peek();
+  if (c == '"') {
+    parse_string();
+    return;
+  }
+  if (c == '{' || c == '[') {
+    int depth = 0;
+    while ((pos = json_find_structural(json, pos)) < json.size()) {
+      const char c = json[pos];
+      if (c == '"') {
+        parse_string();
+        continue;
+      }
+      pos++;
+      if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        depth--;
+        if (depth == 0) {
+          return;
+        }
+      }
+    }
+    throw JsonLoadError("Not expecting the document end");
+  }
+  std::size_t begin = pos;
+  pos = json_find_value_end(json, pos);
+  if (pos == begin) {
+    throw JsonLoadError("Expected a value");
+  }
+}
+
+} // namespace dpack
@@ -0,0 +1,189 @@
+#include "scan.hpp"
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define DPACK_JSON_SSE2
+#include <emmintrin.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define DPACK_JSON_AVX2
+#include <immintrin.h>
+#endif
+
+namespace dpack {
+
+enum class ScanKind { Whitespace, Quote, ValueEnd, Structural };
+
+static bool is_whitespace(char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+template <ScanKind Kind>
+static bool matches(char c) {
+  switch (Kind) {
+  case ScanKind::Whitespace:
+    return !is_whitespace(c);
+  case ScanKind::Quote:
+    return c == '"';
+  case ScanKind::ValueEnd:
+    return is_whitespace(c) || c == ',' || c == '}' || c == ']';
+  case ScanKind::Structural:
+    return c == '"' || c == '{' || c == '}' || c == '[' || c == ']';
+  }
+  return false;
+}
+
+template <ScanKind Kind>
+static std::size_t scan_scalar(std::string_view json, std::size_t pos) {
+  while (pos < json.size() && !matches<Kind>(json[pos])) {
+    pos++;
+  }
+  return pos;
+}
+
+// The vectorised scanners compare a chunk of input against each character of interest, then
+// use the resulting bit mask to find the first match. Any remaining input that doesn't fill a
+// chunk is handled by the scalar scanner.
+
+#ifdef DPACK_JSON_SSE2
+
+namespace sse2 {
+
+static __m128i eq(__m128i chunk, char c) {
+  return _mm_cmpeq_epi8(chunk, _mm_set1_epi8(c));
+}
+
+template <ScanKind Kind>
+static std::size_t scan(std::string_view json, std::size_t pos) {
+  while (pos + 16 <= json.size()) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*)(json.data() + pos));
+    __m128i whitespace = _mm_or_si128(
+        _mm_or_si128(eq(chunk, ' '), eq(chunk, '\n')),
+        _mm_or_si128(eq(chunk, '\t'), eq(chunk, '\r')));
+    std::uint32_t mask = 0;
+    switch (Kind) {
+    case ScanKind::Whitespace:
+      mask = ~_mm_movemask_epi8(whitespace) & 0xffff;
+      break;
+    case ScanKind::Quote:
+      mask = _mm_movemask_epi8(eq(chunk, '"'));
+      break;
+    case ScanKind::ValueEnd:
+      mask = _mm_movemask_epi8(_mm_or_si128(
+          whitespace,
+          _mm_or_si128(eq(chunk, ','), _mm_or_si128(eq(chunk, '}'), eq(chunk, ']')))));
+      break;
+    case ScanKind::Structural:
+      mask = _mm_movemask_epi8(_mm_or_si128(
+          _mm_or_si128(eq(chunk, '"'), eq(chunk, '{')),
+          _mm_or_si128(_mm_or_si128(eq(chunk, '}'), eq(chunk, '[')), eq(chunk, ']'))));
+      break;
+    }
+    if (mask != 0) {
+      return pos + std::countr_zero(mask);
+    }
+    pos += 16;
+  }
+  return scan_scalar<Kind>(json, pos);
+}
+
+} // namespace sse2
+
+#endif
+
+#ifdef DPACK_JSON_AVX2
+
+namespace avx2 {
+
+// Only called if the CPU supports AVX2, see select_scan()
+#define DPACK_AVX2 __attribute__((target("avx2")))
+
+DPACK_AVX2 static __m256i eq(__m256i chunk, char c) {
+  return _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(c));
+}
+
+template <ScanKind Kind>
+DPACK_AVX2 static std::size_t scan(std::string_view json, std::size_t pos) {
+  while (pos + 32 <= json.size()) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i*)(json.data() + pos));
+    __m256i whitespace = _mm256_or_si256(
+        _mm256_or_si256(eq(chunk, ' '), eq(chunk, '\n')),
+        _mm256_or_si256(eq(chunk, '\t'), eq(chunk, '\r')));
+    std::uint32_t mask = 0;
+    switch (Kind) {
+    case ScanKind::Whitespace:
+      mask = ~std::uint32_t(_mm256_movemask_epi8(whitespace));
+      break;
+    case ScanKind::Quote:
+      mask = _mm256_movemask_epi8(eq(chunk, '"'));
+      break;
+    case ScanKind::ValueEnd:
+      mask = _mm256_movemask_epi8(_mm256_or_si256(
+          whitespace,
+          _mm256_or_si256(eq(chunk, ','), _mm256_or_si256(eq(chunk, '}'), eq(chunk, ']')))));
+      break;
+    case ScanKind::Structural:
+      mask = _mm256_movemask_epi8(_mm256_or_si256(
+          _mm256_or_si256(eq(chunk, '"'), eq(chunk, '{')),
+          _mm256_or_si256(_mm256_or_si256(eq(chunk, '}'), eq(chunk, '[')), eq(chunk, ']'))));
+      break;
+    }
+    if (mask != 0) {
+      return pos + std::countr_zero(mask);
+    }
+    pos += 32;
+  }
+  return scan_scalar<Kind>(json, pos);
+}
+
+#undef DPACK_AVX2
+
+} // namespace avx2
+
+#endif
+
+using scan_t = std::size_t (*)(std::string_view, std::size_t);
+
+template <ScanKind Kind>
+static scan_t select_scan() {
+#ifdef DPACK_JSON_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    return avx2::scan<Kind>;
+  }
+#endif
+#ifdef DPACK_JSON_SSE2
+  return sse2::scan<Kind>;
+#else
+  return scan_scalar<Kind>;
+#endif
+}
+
+template <ScanKind Kind>
+static std::size_t scan(std::string_view json, std::size_t pos) {
+  // Most scans are short, so check the first character before dispatching
+  if (pos >= json.size() || matches<Kind>(json[pos])) {
+    return pos;
+  }
+  static const scan_t scan_impl = select_scan<Kind>();
+  return scan_impl(json, pos + 1);
+}
+
+std::size_t json_skip_whitespace(std::string_view json, std::size_t pos) {
+  return scan<ScanKind::Whitespace>(json, pos);
+}
+
+std::size_t json_find_quote(std::string_view json, std::size_t pos) {
+  return scan<ScanKind::Quote>(json, pos);
+}
+
+std::size_t json_find_value_end(std::string_view json, std::size_t pos) {
+  return scan<ScanKind::ValueEnd>(json, pos);
+}
+
+std::size_t json_find_structural(std::string_view json, std::size_t pos) {
+  return scan<ScanKind::Structural>(json, pos);
+}
+
+} // namespace dpack
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace dpack {
+
+// Scanning functions used when parsing JSON. Each returns the position of the first matching
+// character at or after pos, or json.size() if there isn't one.
+// These use SSE2 or AVX2 where available, chosen at runtime, with a scalar fallback otherwise.
+
+// First character that isn't whitespace
+std::size_t json_skip_whitespace(std::string_view json, std::size_t pos);
+
+// First '"'
+std::size_t json_find_quote(std::string_view json, std::size_t pos);
+
+// First whitespace, ',', '}' or ']', ie: the end of a number or literal
+std::size_t json_find_value_end(std::string_view json, std::size_t pos);
+
+// First '"', '{', '}', '[' or ']'
+std::size_t json_find_structural(std::string_view json, std::size_t pos);
+
+} // namespace dpack
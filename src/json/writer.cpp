@@ -0,0 +1,173 @@
+#include "datapack/encode/base64.hpp"
+#include "datapack/encode/floating_string.hpp"
+#include "datapack/json.hpp"
+#include <array>
+#include <charconv>
+#include <ostream>
+
+namespace dpack {
+
+static constexpr std::size_t flush_size = 64 * 1024;
+
+JsonWriter::JsonWriter(std::string& json, bool pretty) :
+    json(json), os(nullptr), pretty(pretty), depth(0), is_first(false) {}
+
+JsonWriter::JsonWriter(std::ostream& os, bool pretty) :
+    json(buffer), os(&os), pretty(pretty), depth(0), is_first(false) {}
+
+template <typename T>
+static void append_integer(std::string& json, T value) {
+  std::array<char, 24> string;
+  auto res = std::to_chars(string.data(), string.data() + string.size(), value);
+  json.append(string.data(), res.ptr - string.data());
+}
+
+void JsonWriter::number(NumberType type, const void* value) {
+  switch (type) {
+  case NumberType::I32:
+    append_integer(json, *(const std::int32_t*)value);
+    break;
+  case NumberType::I64:
+    append_integer(json, *(const std::int64_t*)value);
+    break;
+  case NumberType::U32:
+    append_integer(json, *(const std::uint32_t*)value);
+    break;
+  case NumberType::U64:
+    append_integer(json, *(const std::uint64_t*)value);
+    break;
+  case NumberType::U8:
+    append_integer(json, *(const std::uint8_t*)value);
+    break;
+  case NumberType::F32:
+    json += floating_to_string(*(const float*)value);
+    break;
+  case NumberType::F64:
+    json += floating_to_string(*(const double*)value);
+    break;
+  }
+}
+
+void JsonWriter::boolean(bool value) {
+  json += (value ? "true" : "false");
+}
+
+void JsonWriter::string(const char* value) {
+  json += '"';
+  json += value;
+  json += '"';
+}
+
+void JsonWriter::enumerate(int value, const std::span<const char*>& labels) {
+  string(labels[value]);
+}
+
+void JsonWriter::binary(const std::span<const std::uint8_t>& data) {
+  json += '"';
+  json += base64_encode(data);
+  json += '"';
+}
+
+void JsonWriter::optional_begin(bool has_value) {
+  if (!has_value) {
+    json += "null";
+  }
+}
+
+void JsonWriter::optional_end() {
+  // Do nothing
+}
+
+void JsonWriter::variant_begin(int value, const std::span<const char*>& labels) {
+  object_begin();
+  object_next("type");
+  string(labels[value]);
+  std::string value_key = "value_" + std::string(labels[value]);
+  object_next(value_key.c_str());
+}
+
+void JsonWriter::variant_end() {
+  object_end();
+}
+
+void JsonWriter::object_begin() {
+  container_begin('{');
+}
+
+void JsonWriter::object_next(const char* key) {
+  container_next();
+  string(key);
+  json += (pretty ? ": " : ":");
+}
+
+void JsonWriter::object_end() {
+  container_end('}');
+}
+
+void JsonWriter::tuple_begin() {
+  container_begin('[');
+}
+
+void JsonWriter::tuple_next() {
+  container_next();
+}
+
+void JsonWriter::tuple_end() {
+  container_end(']');
+}
+
+void JsonWriter::list_begin(size_t size) {
+  container_begin('[');
+}
+
+void JsonWriter::list_next() {
+  container_next();
+}
+
+void JsonWriter::list_end() {
+  container_end(']');
+}
+
+void JsonWriter::finish() {
+  if (os) {
+    os->write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+}
+
+void JsonWriter::container_begin(char c) {
+  json += c;
+  depth++;
+  is_first = true;
+}
+
+void JsonWriter::container_next() {
+  if (!is_first) {
+    json += ',';
+  }
+  is_first = false;
+  indent();
+
+  if (os && buffer.size() >= flush_size) {
+    finish();
+  }
+}
+
+void JsonWriter::container_end(char c) {
+  depth--;
+  if (!is_first) {
+    indent();
+  }
+  is_first = false;
+  json += c;
+}
+
+void JsonWriter::indent() {
+  if (!pretty) {
+    return;
+  }
+  json += '\n';
+  json.append(4 * depth, ' ');
+}
+
+} // namespace dpack
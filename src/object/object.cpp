@@ -1,6 +1,12 @@
 #include "datapack/object.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
 #include <iomanip>
 #include <stack>
+#include <string_view>
 
 namespace dpack::object {
 
@@ -16,71 +22,81 @@ static bool binary_match(const binary_t& lhs, const binary_t& rhs) {
   return true;
 }
 
-bool operator==(ConstObject lhs_root, ConstObject rhs_root) {
-  std::stack<std::pair<ConstObject::Ptr, ConstObject::Ptr>> stack;
-  stack.emplace(lhs_root.ptr(), rhs_root.ptr());
-  bool at_root = true;
-
-  while (!stack.empty()) {
-    auto [lhs, rhs] = stack.top();
-    stack.pop();
-
-    if (!at_root) {
-      if (lhs.key() != rhs.key()) {
-        return false;
-      }
-    }
-
-    if (auto lhs_number = lhs->number_if()) {
-      auto rhs_number = rhs->number_if();
-      if (!rhs_number || *lhs_number != *rhs_number) {
-        return false;
-      }
+// Compares the values of two nodes, ignoring their children
+static bool values_match(const Tree& lhs_tree, int lhs, const Tree& rhs_tree, int rhs) {
+  if (auto lhs_number = lhs_tree.get_if<number_t>(lhs)) {
+    auto rhs_number = rhs_tree.get_if<number_t>(rhs);
+    if (!rhs_number || *lhs_number != *rhs_number) {
+      return false;
     }
-    if (auto lhs_string = lhs->string_if()) {
-      auto rhs_string = rhs->string_if();
-      if (!rhs_string || *lhs_string != *rhs_string) {
-        return false;
-      }
+  }
+  if (auto lhs_string = lhs_tree.get_if<std::string>(lhs)) {
+    auto rhs_string = rhs_tree.get_if<std::string>(rhs);
+    if (!rhs_string || *lhs_string != *rhs_string) {
+      return false;
     }
-    if (auto lhs_boolean = lhs->boolean_if()) {
-      auto rhs_boolean = rhs->boolean_if();
-      if (!rhs_boolean || *lhs_boolean != *rhs_boolean) {
-        return false;
-      }
+  }
+  if (auto lhs_boolean = lhs_tree.get_if<bool>(lhs)) {
+    auto rhs_boolean = rhs_tree.get_if<bool>(rhs);
+    if (!rhs_boolean || *lhs_boolean != *rhs_boolean) {
+      return false;
     }
-    if (auto lhs_binary = lhs->binary_if()) {
-      auto rhs_binary = rhs->binary_if();
-      if (!rhs_binary || !binary_match(*lhs_binary, *rhs_binary)) {
-        return false;
-      }
+  }
+  if (auto lhs_binary = lhs_tree.get_if<binary_t>(lhs)) {
+    auto rhs_binary = rhs_tree.get_if<binary_t>(rhs);
+    if (!rhs_binary || !binary_match(*lhs_binary, *rhs_binary)) {
+      return false;
     }
+  }
+  return true;
+}
 
-    if (!at_root) {
-      if (lhs.next()) {
-        if (!rhs.next()) {
-          return false;
-        }
-        stack.emplace(lhs.next(), rhs.next());
-      } else if (rhs.next()) {
-        return false;
-      }
+// Compares the keys of the children of two nodes, calling func(lhs_child, rhs_child) on each
+// pair. Returns false if the keys or number of children differ.
+template <typename Func>
+static bool children_match(
+    const Tree& lhs_tree,
+    int lhs,
+    const Tree& rhs_tree,
+    int rhs,
+    const Func& func) {
+  int lhs_child = lhs_tree[lhs].child;
+  int rhs_child = rhs_tree[rhs].child;
+  while (lhs_child != -1 && rhs_child != -1) {
+    if (lhs_tree.key(lhs_child) != rhs_tree.key(rhs_child)) {
+      return false;
     }
+    func(lhs_child, rhs_child);
+    lhs_child = lhs_tree[lhs_child].next;
+    rhs_child = rhs_tree[rhs_child].next;
+  }
+  return lhs_child == -1 && rhs_child == -1;
+}
 
-    if (lhs.child()) {
-      if (!rhs.child()) {
-        return false;
-      }
-      stack.emplace(lhs.child(), rhs.child());
-    } else if (rhs.child()) {
+// Compares the subtrees under two nodes, ignoring the keys of the nodes themselves
+static bool subtrees_match(const Tree& lhs_tree, int lhs_root, const Tree& rhs_tree, int rhs_root) {
+  std::stack<std::pair<int, int>> stack;
+  stack.emplace(lhs_root, rhs_root);
+  auto push = [&stack](int lhs_child, int rhs_child) { stack.emplace(lhs_child, rhs_child); };
+  while (!stack.empty()) {
+    auto [lhs, rhs] = stack.top();
+    stack.pop();
+    if (!values_match(lhs_tree, lhs, rhs_tree, rhs)) {
+      return false;
+    }
+    if (!children_match(lhs_tree, lhs, rhs_tree, rhs, push)) {
       return false;
     }
-
-    at_root = false;
   }
   return true;
 }
 
+bool operator==(ConstObject lhs, ConstObject rhs) {
+  const TreeRef lhs_ref(lhs);
+  const TreeRef rhs_ref(rhs);
+  return subtrees_match(lhs_ref.tree, lhs_ref.node, rhs_ref.tree, rhs_ref.node);
+}
+
 #if 0
 bool operator==(ConstObject lhs, const object::primitive_t& rhs) {
   if (auto rhs_int = std::get_if<int>(&rhs)) {
@@ -108,6 +124,123 @@ bool operator==(ConstObject lhs, const object::primitive_t& rhs) {
 }
 #endif
 
+// The finaliser from splitmix64, so that combining hashes depends on their order
+static std::uint64_t hash_combine(std::uint64_t seed, std::uint64_t value) {
+  std::uint64_t x = seed + 0x9e3779b97f4a7c15 + value;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+
+static void hash_combine(ObjectHash& hash, const ObjectHash& value) {
+  hash.low = hash_combine(hash.low, value.low);
+  hash.high = hash_combine(hash.high, value.high);
+}
+
+static void hash_combine(ObjectHash& hash, std::uint64_t value) {
+  hash_combine(hash, ObjectHash{value, value});
+}
+
+// The high half combines the bytes 8 at a time, so it is independent of std::hash
+static ObjectHash hash_bytes(const void* data, std::size_t size) {
+  const std::uint8_t* bytes = (const std::uint8_t*)data;
+  std::uint64_t high = hash_combine(0, size);
+  for (std::size_t i = 0; i < size; i += 8) {
+    std::uint64_t word = 0;
+    std::memcpy(&word, bytes + i, std::min<std::size_t>(8, size - i));
+    high = hash_combine(high, word);
+  }
+  return {std::hash<std::string_view>{}(std::string_view((const char*)data, size)), high};
+}
+
+ObjectHashes::ObjectHashes(ConstObject root, std::size_t threads) :
+    tree(root.tree), hashes(tree->capacity()) {
+  threads = parallel_thread_count(threads);
+  if (threads == 1) {
+    hash_subtree(root.node);
+    return;
+  }
+
+  // Expand nodes breadth-first until there are enough subtrees to hash in parallel, then hash
+  // the expanded nodes in reverse, after their children
+  std::vector<int> expanded;
+  std::vector<int> subtrees = {root.node};
+  while (!subtrees.empty() && subtrees.size() < threads * parallel_tasks_per_thread) {
+    std::vector<int> next_subtrees;
+    for (int node : subtrees) {
+      expanded.push_back(node);
+      for (int child = (*tree)[node].child; child != -1; child = (*tree)[child].next) {
+        next_subtrees.push_back(child);
+      }
+    }
+    subtrees = std::move(next_subtrees);
+  }
+
+  parallel_for(subtrees.size(), threads, [&](std::size_t i) { hash_subtree(subtrees[i]); });
+  for (auto iter = expanded.rbegin(); iter != expanded.rend(); iter++) {
+    hash_node(*iter);
+  }
+}
+
+void ObjectHashes::hash_subtree(int root) {
+  // Visit the nodes in pre-order, then hash them in reverse so children come before parents
+  std::vector<int> order;
+  std::stack<int> stack;
+  stack.push(root);
+  while (!stack.empty()) {
+    int node = stack.top();
+    stack.pop();
+    order.push_back(node);
+    for (int child = (*tree)[node].child; child != -1; child = (*tree)[child].next) {
+      stack.push(child);
+    }
+  }
+  for (auto iter = order.rbegin(); iter != order.rend(); iter++) {
+    hash_node(*iter);
+  }
+}
+
+void ObjectHashes::hash_node(int node) {
+  const Node& value = (*tree)[node];
+  // The halves start from different seeds, so don't collide for the same inputs
+  ObjectHash hash = {0, 1};
+  hash_combine(hash, std::uint64_t(value.type));
+  switch (value.type) {
+  case NodeType::Number:
+    // Equal numbers must hash equally, including 0.0 and -0.0
+    hash_combine(hash, std::bit_cast<std::uint64_t>(value.number + 0.0));
+    break;
+  case NodeType::Boolean:
+    hash_combine(hash, value.boolean);
+    break;
+  case NodeType::String: {
+    const auto& string = tree->get<std::string>(node);
+    hash_combine(hash, hash_bytes(string.data(), string.size()));
+    break;
+  }
+  case NodeType::Binary: {
+    const auto& binary = tree->get<binary_t>(node);
+    hash_combine(hash, hash_bytes(binary.data(), binary.size()));
+    break;
+  }
+  default:
+    break;
+  }
+  for (int child = value.child; child != -1; child = (*tree)[child].next) {
+    const std::string& key = tree->key(child);
+    hash_combine(hash, hash_bytes(key.data(), key.size()));
+    hash_combine(hash, hashes[child]);
+  }
+  hashes[node] = hash;
+}
+
+ObjectHash ObjectHashes::operator()(ConstObject object) const {
+  if (object.tree != tree) {
+    throw UsageError("Object is not part of the hashed tree");
+  }
+  return hashes[object.node];
+}
+
 std::ostream& operator<<(std::ostream& os, ConstObject object) {
   struct State {
     ConstObject::Ptr node;
@@ -189,7 +322,7 @@ std::ostream& operator<<(std::ostream& os, ConstObject object) {
 
 namespace dpack {
 
-void object_prune(Object object) {
+static void prune(Object object) {
   if (!object.is_map()) {
     return;
   }
@@ -230,48 +363,190 @@ void object_prune(Object object) {
   }
 }
 
-Object object_merge(ConstObject base_root, ConstObject diff_root) {
+// True if prune() would modify the given map
+static bool needs_prune(const object::TreeRef& ref) {
+  const object::Tree& tree = ref.tree;
+  std::stack<int> stack;
+  stack.push(ref.node);
+  while (!stack.empty()) {
+    int node = stack.top();
+    stack.pop();
+    if (tree[node].child == -1) {
+      return true;
+    }
+    for (int child = tree[node].child; child != -1; child = tree[child].next) {
+      if (tree.holds<object::null_t>(child)) {
+        return true;
+      }
+      if (tree.holds<object::map_t>(child)) {
+        stack.push(child);
+      }
+    }
+  }
+  return false;
+}
+
+void object_prune(Object object, std::size_t threads) {
+  threads = object::parallel_thread_count(threads);
+  if (!object.is_map()) {
+    return;
+  }
+
+  // Expand maps breadth-first until there are enough subtrees to check in parallel. Only the
+  // subtrees that need it are pruned, followed by the expanded maps, deepest first. Checking is
+  // read only, so this is faster than pruning directly even with a single thread.
+  std::vector<Object::Ptr> expanded;
+  std::vector<Object::Ptr> subtrees = {object.ptr()};
+  while (!subtrees.empty() && subtrees.size() < threads * object::parallel_tasks_per_thread) {
+    std::vector<Object::Ptr> next_subtrees;
+    for (const auto& node : subtrees) {
+      expanded.push_back(node);
+      for (auto child = node.child(); child; child = child.next()) {
+        if (child->is_map()) {
+          next_subtrees.push_back(child);
+        }
+      }
+    }
+    subtrees = std::move(next_subtrees);
+  }
+
+  std::vector<char> needed(subtrees.size());
+  object::parallel_for(subtrees.size(), threads, [&](std::size_t i) {
+    needed[i] = needs_prune(object::TreeRef(*subtrees[i]));
+  });
+  for (std::size_t i = 0; i < subtrees.size(); i++) {
+    if (needed[i]) {
+      prune(*subtrees[i]);
+    }
+  }
+
+  for (auto iter = expanded.rbegin(); iter != expanded.rend(); iter++) {
+    auto child = iter->child();
+    while (child) {
+      auto next = child.next();
+      if (child->is_null()) {
+        child->erase();
+      }
+      child = next;
+    }
+    if ((*iter)->size() == 0) {
+      (*iter)->erase();
+    }
+  }
+}
+
+bool object_equal(ConstObject lhs, ConstObject rhs, std::size_t threads) {
+  threads = object::parallel_thread_count(threads);
+  if (threads == 1) {
+    return lhs == rhs;
+  }
+
+  const object::TreeRef lhs_ref(lhs);
+  const object::TreeRef rhs_ref(rhs);
+  const object::Tree& lhs_tree = lhs_ref.tree;
+  const object::Tree& rhs_tree = rhs_ref.tree;
+
+  // Expand nodes breadth-first, comparing their values and the keys of their children, until
+  // there are enough subtrees to compare in parallel
+  std::vector<std::pair<int, int>> subtrees = {{lhs_ref.node, rhs_ref.node}};
+  while (!subtrees.empty() && subtrees.size() < threads * object::parallel_tasks_per_thread) {
+    std::vector<std::pair<int, int>> next_subtrees;
+    auto push = [&next_subtrees](int lhs_child, int rhs_child) {
+      next_subtrees.emplace_back(lhs_child, rhs_child);
+    };
+    for (auto [lhs, rhs] : subtrees) {
+      if (!object::values_match(lhs_tree, lhs, rhs_tree, rhs) ||
+          !object::children_match(lhs_tree, lhs, rhs_tree, rhs, push)) {
+        return false;
+      }
+    }
+    subtrees = std::move(next_subtrees);
+  }
+
+  std::atomic<bool> equal = true;
+  object::parallel_for(subtrees.size(), threads, [&](std::size_t i) {
+    auto [lhs, rhs] = subtrees[i];
+    if (equal && !object::subtrees_match(lhs_tree, lhs, rhs_tree, rhs)) {
+      equal = false;
+    }
+  });
+  return equal;
+}
+
+Object object_merge(ConstObject base_root, ConstObject diff_root, std::size_t threads) {
+  // The copy shares storage with base, see object::Tree
   Object merged_root;
+  merged_root = base_root;
+  object_merge_into(merged_root, diff_root, threads);
+  // object_merge_into() only prunes what the diff changed
+  object_prune(merged_root, threads);
+  return merged_root;
+}
 
+void object_merge_into(Object base_root, ConstObject diff_root, std::size_t threads) {
   struct State {
-    ConstObject::Ptr base;
+    Object::Ptr base;
     ConstObject::Ptr diff;
-    Object::Ptr merged;
   };
   std::stack<State> stack;
-  stack.emplace(base_root.ptr(), diff_root.ptr(), merged_root.ptr());
+  stack.emplace(base_root.ptr(), diff_root.ptr());
+
+  // Nodes assigned or inserted by the merge, which are the only ones that need pruning
+  std::vector<Object::Ptr> changed;
 
   while (!stack.empty()) {
-    auto [base, diff, merged] = stack.top();
+    auto [base, diff] = stack.top();
     stack.pop();
 
     if (!base->is_map() || !diff->is_map()) {
-      *merged = *diff;
+      *base = *diff;
+      changed.push_back(base);
       continue;
     }
-    merged->to_map();
-
-    for (auto iter = base->items().begin(); iter != base->items().end(); iter++) {
-      auto [key, value] = *iter;
-      if (!diff->contains(key)) {
-        (*merged)[key] = value;
-      } else {
-        stack.emplace(value.ptr(), diff->find(key), (*merged)[key].ptr());
-      }
-    }
     for (auto [key, value] : diff->items()) {
-      if (!base->contains(key)) {
-        (*merged)[key] = value;
+      if (auto base_ptr = base->find(key)) {
+        stack.emplace(base_ptr, value.ptr());
+      } else {
+        changed.push_back(base->insert(key, value).ptr());
       }
     }
   }
 
-  object_prune(merged_root);
+  // Prune the changed nodes, and any maps along their paths that this leaves empty. The changed
+  // nodes are disjoint subtrees, so erasing one never erases another.
+  const int root_node = object::TreeRef(base_root).node;
+  auto is_root = [root_node](const Object::Ptr& node) {
+    return object::TreeRef(*node).node == root_node;
+  };
+  for (const auto& node : changed) {
+    if (is_root(node)) {
+      object_prune(base_root, threads);
+      break;
+    }
+    auto parent = node.parent();
+    if (node->is_null()) {
+      node->erase();
+    } else if (node->is_map()) {
+      prune(*node);
+    }
+    while (!is_root(parent) && parent->size() == 0) {
+      auto next = parent.parent();
+      parent->erase();
+      parent = next;
+    }
+  }
 
-  return merged_root;
+  // A long-lived root that is repeatedly merged into accumulates free nodes, so compact it
+  if (!base_root.ptr().parent() && object::TreeRef(base_root).tree.fragmented()) {
+    base_root.compact();
+  }
 }
 
-Object object_diff(ConstObject base_root, ConstObject modified_root) {
+Object object_diff(ConstObject base_root, ConstObject modified_root, std::size_t threads) {
+  // Hashing is most of the work, and is done in parallel. Otherwise the diff only visits the
+  // parts of the trees that differ.
+  const object::ObjectHashes base_hashes(base_root, threads);
+  const object::ObjectHashes modified_hashes(modified_root, threads);
   Object diff_root;
 
   struct State {
@@ -287,25 +562,28 @@ Object object_diff(ConstObject base_root, ConstObject modified_root) {
     stack.pop();
 
     if (!base->is_map() || !modified->is_map()) {
-      if (*base != *modified) {
+      if (base_hashes(*base) != modified_hashes(*modified)) {
         *diff = *modified;
       }
       continue;
     }
     diff->to_map();
 
+    // Only add keys to the diff for values that differ
+    std::size_t matched = 0;
     for (auto [key, value] : modified->items()) {
       if (auto base_ptr = base->find(key)) {
-        stack.emplace(base_ptr, value.ptr(), (*diff)[key].ptr());
+        matched++;
+        if (base_hashes(*base_ptr) != modified_hashes(value)) {
+          stack.emplace(base_ptr, value.ptr(), (*diff)[key].ptr());
+        }
       } else {
         (*diff)[key] = value;
       }
     }
-    for (auto [key, value] : base->items()) {
-      if (!modified->contains(key)) {
-        throw object::UsageError("Cannot evaluate object_diff(base, modified) where there are keys "
-                                 "in base that aren't in modified ");
-      }
+    if (matched != base->size()) {
+      throw object::UsageError("Cannot evaluate object_diff(base, modified) where there are keys "
+                               "in base that aren't in modified ");
     }
   }
 
@@ -0,0 +1,62 @@
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dpack::object {
+
+std::size_t parallel_thread_count(std::size_t threads) {
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  return std::max<std::size_t>(threads, 1);
+}
+
+void parallel_for(
+    std::size_t count,
+    std::size_t threads,
+    const std::function<void(std::size_t)>& func) {
+  threads = std::min(parallel_thread_count(threads), count);
+  if (threads <= 1) {
+    for (std::size_t i = 0; i < count; i++) {
+      func(i);
+    }
+    return;
+  }
+
+  std::atomic<std::size_t> next = 0;
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  auto worker = [&]() {
+    std::size_t i;
+    while ((i = next++) < count) {
+      try {
+        func(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        next = count;
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (std::size_t i = 1; i < threads; i++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : pool) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+} // namespace dpack::object
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace dpack::object {
+
+// Helpers for the parallel versions of the object functions, which take a number of threads,
+// where 0 means one per hardware thread.
+
+std::size_t parallel_thread_count(std::size_t threads);
+
+// Enough tasks per thread that uneven subtrees still balance out
+static constexpr std::size_t parallel_tasks_per_thread = 16;
+
+// Calls func(i) for each i in [0, count) across the given number of threads, including the
+// calling thread. Tasks are claimed from a shared counter, so threads that finish their tasks
+// early take more of the remainder. The first exception thrown by a task is rethrown.
+void parallel_for(
+    std::size_t count,
+    std::size_t threads,
+    const std::function<void(std::size_t)>& func);
+
+} // namespace dpack::object
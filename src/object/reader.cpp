@@ -123,22 +123,23 @@ void ObjectReader::object_end() {
   node = node.parent();
 }
 
-void ObjectReader::object_next(const char* key) {
+bool ObjectReader::object_next(const char* key) {
   auto parent = node.parent();
   if (!parent) {
     invalidate();
-    return;
+    return false;
   }
   if (!parent->is_map()) {
     invalidate();
-    return;
+    return false;
   }
   auto next = parent->find(std::string(key));
   if (!next) {
     invalidate();
-    return;
+    return false;
   }
   node = next;
+  return true;
 }
 
 void ObjectReader::tuple_begin() {
@@ -1,22 +1,46 @@
 #include "datapack/object.hpp"
+#include <utility>
 
 namespace dpack::object {
 
-void Tree::set_node(int index, const value_t& value) {
+static std::size_t key_hash(const std::string& key) {
+  return std::hash<std::string>{}(key);
+}
+
+Tree::Tree() : key_table(std::make_shared<KeyTable>()) {
+  // Key 0 is the empty key, used by list elements and root nodes
+  key_table->keys.emplace_back();
+}
+
+void Tree::set_node(int index, value_t value) {
+  release_refs();
   clear_node(index);
-  nodes[index].value = value;
+  set_value(index, std::move(value));
+  if (index == 0 && fragmented()) {
+    compact();
+  }
 }
 
 void Tree::clear_node(int index) {
+  release_refs();
   if (index == -1) {
     return;
   }
+  if (!map_indexes.empty()) {
+    map_indexes.erase(index);
+  }
+  if (!list_indexes.empty()) {
+    list_indexes.erase(index);
+  }
   if (nodes[index].child == -1) {
     return;
   }
 
-  int child = nodes[index].child;
-  nodes[index].child = -1;
+  Node& node = nodes.mut(index);
+  int child = node.child;
+  node.child = -1;
+  node.last_child = -1;
+  node.child_count = 0;
 
   std::stack<int> to_remove;
   to_remove.push(child);
@@ -31,9 +55,11 @@ void Tree::clear_node(int index) {
     }
     pop_node(node);
   }
+  compact_unused_keys();
 }
 
 void Tree::erase_node(int index) {
+  release_refs();
   if (index == -1) {
     return;
   }
@@ -44,37 +70,47 @@ void Tree::erase_node(int index) {
   int next = nodes[index].next;
 
   if (prev != -1) {
-    nodes[prev].next = next;
+    nodes.mut(prev).next = next;
   } else if (parent != -1) {
-    nodes[parent].child = next;
+    nodes.mut(parent).child = next;
   }
   if (next != -1) {
-    nodes[next].prev = prev;
+    nodes.mut(next).prev = prev;
   }
 
-  pop_node(index);
-}
-
-int Tree::insert_node(const value_t& value, const std::string& key, int parent, int prev) {
-  int node = emplace_node(value, key, parent, prev);
+  if (parent != -1) {
+    Node& parent_node = nodes.mut(parent);
+    if (parent_node.last_child == index) {
+      parent_node.last_child = prev;
+    }
+    parent_node.child_count--;
 
-  if (prev != -1) {
-    nodes[node].next = nodes[prev].next;
-    nodes[prev].next = node;
-  } else if (parent != -1) {
-    nodes[node].next = nodes[parent].child;
-    nodes[parent].child = node;
+    if (MapIndex* map_index = find_mutable_map_index(parent)) {
+      erase_indexed_node(*map_index, index);
+    }
+    if (find_list_index(parent)) {
+      if (next == -1) {
+        find_mutable_list_index(parent)->pop_back();
+      } else {
+        list_indexes.erase(parent);
+      }
+    }
   }
 
-  int next = nodes[node].next;
-  if (next != -1) {
-    nodes[next].prev = node;
-  }
+  pop_node(index);
+  compact_unused_keys();
+}
 
+int Tree::insert_node(value_t value, const std::string& key, int parent, int prev) {
+  release_refs();
+  int node = emplace_node(intern_key(key), parent, prev);
+  set_value(node, std::move(value));
+  link_node(node);
   return node;
 }
 
 void Tree::copy_node(int to, const Tree& nodes_from, int from) {
+  release_refs();
   if (&nodes_from == this) {
     if (to == from) {
       throw UsageError("Cannot copy to the same node");
@@ -89,8 +125,15 @@ void Tree::copy_node(int to, const Tree& nodes_from, int from) {
         throw UsageError("Cannot copy from a node to its ancestor");
       }
     }
+  } else if (to == 0 && from == 0) {
+    // Copying a whole tree, so share its storage
+    *this = nodes_from;
+    return;
   }
 
+  // Replaces any existing children
+  clear_node(to);
+
   std::stack<std::pair<int, int>> stack;
   stack.emplace(to, from);
   bool at_root = true;
@@ -99,39 +142,54 @@ void Tree::copy_node(int to, const Tree& nodes_from, int from) {
     auto [to, from] = stack.top();
     stack.pop();
 
-    nodes[to].value = nodes_from[from].value;
-    if (!at_root) {
-      nodes[to].key = nodes_from[from].key;
+    copy_value(to, nodes_from, from);
+    if (nodes_from.find_map_index(from)) {
+      create_map_index(to);
+    }
+    if (nodes_from.find_list_index(from)) {
+      create_list_index(to);
     }
 
+    // Keys are set before linking so the parent's key index (if any) stays up to date
     int from_next = nodes_from[from].next;
     if (!at_root && from_next != -1) {
-      int to_next = insert_node(null_t(), "", nodes[to].parent, to);
+      int to_next = emplace_node(copy_key(nodes_from, from_next), nodes[to].parent, to);
+      link_node(to_next);
       stack.emplace(to_next, from_next);
     }
 
     int from_child = nodes_from[from].child;
     if (from_child != -1) {
-      int to_child = insert_node(null_t(), "", to, -1);
+      int to_child = emplace_node(copy_key(nodes_from, from_child), to, -1);
+      link_node(to_child);
       stack.emplace(to_child, from_child);
     }
 
     at_root = false;
   }
+
+  if (to == 0 && fragmented()) {
+    compact();
+  }
 }
 
 int Tree::find_map_node(int root, const std::string& key, bool required) const {
   assert(root != -1);
-  if (!std::get_if<map_t>(&nodes[root].value)) {
+  if (!holds<map_t>(root)) {
     throw TypeError("Expected map node");
   }
 
-  int node = nodes[root].child;
-  while (node != -1) {
-    if (nodes[node].key == key) {
-      return node;
+  int node = -1;
+  if (const MapIndex* map_index = find_map_index(root)) {
+    node = find_indexed_node(*map_index, key);
+  } else {
+    node = nodes[root].child;
+    while (node != -1 && this->key(node) != key) {
+      node = nodes[node].next;
     }
-    node = nodes[node].next;
+  }
+  if (node != -1) {
+    return node;
   }
   if (required) {
     throw KeyError("Key '" + key + "' does not exist");
@@ -141,95 +199,512 @@ int Tree::find_map_node(int root, const std::string& key, bool required) const {
 
 int Tree::find_or_create_map_node(int root, const std::string& key) {
   assert(root != -1);
-  if (!std::get_if<map_t>(&nodes[root].value)) {
+  if (!holds<map_t>(root)) {
     throw TypeError("Expected map node");
   }
 
+  if (const MapIndex* map_index = find_map_index(root)) {
+    int node = find_indexed_node(*map_index, key);
+    if (node != -1) {
+      return node;
+    }
+    return insert_node(null_t(), key, root, nodes[root].last_child);
+  }
+
   int node = nodes[root].child;
-  int prev = -1;
   while (node != -1) {
-    if (nodes[node].key == key) {
+    if (this->key(node) == key) {
       return node;
     }
-    prev = node;
     node = nodes[node].next;
   }
-  return insert_node(null_t(), key, root, prev);
+  node = insert_node(null_t(), key, root, nodes[root].last_child);
+  if (std::size_t(nodes[root].child_count) >= map_index_threshold) {
+    create_map_index(root);
+  }
+  return node;
 }
 
-int Tree::insert_map_node(int root, const std::string& key, const value_t& value) {
+int Tree::insert_map_node(int root, const std::string& key, value_t value) {
   assert(root != -1);
-  if (!std::get_if<map_t>(&nodes[root].value)) {
+  if (!holds<map_t>(root)) {
     throw TypeError("Expected map node");
   }
 
+  if (const MapIndex* map_index = find_map_index(root)) {
+    if (find_indexed_node(*map_index, key) != -1) {
+      throw KeyError("Element with key '" + key + "' already exists");
+    }
+    return insert_node(std::move(value), key, root, nodes[root].last_child);
+  }
+
   int node = nodes[root].child;
-  int prev = -1;
   while (node != -1) {
-    if (nodes[node].key == key) {
+    if (this->key(node) == key) {
       throw KeyError("Element with key '" + key + "' already exists");
     }
-    prev = node;
     node = nodes[node].next;
   }
-  return insert_node(value, key, root, prev);
+  node = insert_node(std::move(value), key, root, nodes[root].last_child);
+  if (std::size_t(nodes[root].child_count) >= map_index_threshold) {
+    create_map_index(root);
+  }
+  return node;
 }
 
 int Tree::find_list_node(int root, std::size_t index) const {
   assert(root != -1);
-  if (!std::get_if<list_t>(&nodes[root].value)) {
+  if (!holds<list_t>(root)) {
     throw TypeError("Expected list node");
   }
 
-  int node = nodes[root].child;
-  std::size_t i = 0;
-  while (node != -1 && i < index) {
-    node = nodes[node].next;
-    i++;
+  const std::size_t count = nodes[root].child_count;
+  if (index >= count) {
+    return -1;
+  }
+  if (const ListIndex* list_index = find_list_index(root)) {
+    return (*list_index)[index];
+  }
+
+  // Walk from whichever end is closer
+  if (index < count / 2) {
+    int node = nodes[root].child;
+    for (std::size_t i = 0; i < index; i++) {
+      node = nodes[node].next;
+    }
+    return node;
+  }
+  int node = nodes[root].last_child;
+  for (std::size_t i = count - 1; i > index; i--) {
+    node = nodes[node].prev;
   }
   return node;
 }
 
-int Tree::insert_list_node(int root, const value_t& value) {
+int Tree::find_list_node(int root, std::size_t index) {
+  assert(root != -1);
+  if (holds<list_t>(root) && std::size_t(nodes[root].child_count) >= list_index_threshold &&
+      !find_list_index(root)) {
+    create_list_index(root);
+  }
+  return std::as_const(*this).find_list_node(root, index);
+}
+
+int Tree::insert_list_node(int root, value_t value) {
   assert(root != -1);
-  if (!std::get_if<list_t>(&nodes[root].value)) {
+  if (!holds<list_t>(root)) {
     throw TypeError("Expected list node");
   }
 
-  int node = nodes[root].child;
-  int prev = -1;
-  while (node != -1) {
-    prev = node;
-    node = nodes[node].next;
+  int node = insert_node(std::move(value), "", root, nodes[root].last_child);
+  if (std::size_t(nodes[root].child_count) >= list_index_threshold && !find_list_index(root)) {
+    create_list_index(root);
   }
-  return insert_node(value, "", root, prev);
+  return node;
 }
 
 std::size_t Tree::node_child_count(int node) const {
-  node = nodes[node].child;
-  std::size_t count = 0;
-  while (node != -1) {
-    count++;
-    node = nodes[node].next;
+  return nodes[node].child_count;
+}
+
+void Tree::compact() {
+  release_refs();
+  if (nodes.empty() || free.size() == nodes.size()) {
+    return;
+  }
+
+  // Depth-first order, with children in order
+  std::vector<int> order;
+  order.reserve(size());
+  std::stack<int> stack;
+  stack.push(0);
+  while (!stack.empty()) {
+    int node = stack.top();
+    stack.pop();
+    order.push_back(node);
+    for (int child = nodes[node].last_child; child != -1; child = nodes[child].prev) {
+      stack.push(child);
+    }
+  }
+
+  std::vector<int> remap(nodes.size(), -1);
+  for (std::size_t i = 0; i < order.size(); i++) {
+    remap[order[i]] = i;
+  }
+  auto remap_index = [&remap](int index) { return index == -1 ? -1 : remap[index]; };
+
+  PagedVector<Node, 256> new_nodes;
+  new_nodes.reserve(order.size());
+  PagedVector<std::string, 64> new_strings;
+  PagedVector<binary_t, 1> new_binaries;
+  for (int index : order) {
+    Node node = nodes[index];
+    node.parent = remap_index(node.parent);
+    node.child = remap_index(node.child);
+    node.last_child = remap_index(node.last_child);
+    node.prev = remap_index(node.prev);
+    node.next = remap_index(node.next);
+    if (node.type == NodeType::String) {
+      new_strings.push_back(std::move(strings.mut(node.data)));
+      node.data = new_strings.size() - 1;
+    } else if (node.type == NodeType::Binary) {
+      new_binaries.push_back(std::move(binaries.mut(node.data)));
+      node.data = new_binaries.size() - 1;
+    }
+    new_nodes.push_back(node);
+  }
+
+  nodes = std::move(new_nodes);
+  free.clear();
+  strings = std::move(new_strings);
+  free_strings.clear();
+  binaries = std::move(new_binaries);
+  free_binaries.clear();
+
+  std::vector<int> map_roots;
+  for (const auto& [root, map_index] : map_indexes) {
+    map_roots.push_back(remap[root]);
   }
-  return count;
+  map_indexes.clear();
+  for (int root : map_roots) {
+    create_map_index(root);
+  }
+
+  std::vector<int> list_roots;
+  for (const auto& [root, list_index] : list_indexes) {
+    list_roots.push_back(remap[root]);
+  }
+  list_indexes.clear();
+  for (int root : list_roots) {
+    create_list_index(root);
+  }
+
+  compact_keys();
+}
+
+bool Tree::fragmented() const {
+  return nodes.size() >= compact_min_nodes && free.size() * 2 >= nodes.size();
+}
+
+void Tree::rename_node(int node, const std::string& key) {
+  release_refs();
+  int parent = nodes[node].parent;
+  if (parent == -1 || !holds<map_t>(parent)) {
+    throw TypeError("Expected map element");
+  }
+  if (this->key(node) == key) {
+    return;
+  }
+  if (find_map_node(parent, key, false) != -1) {
+    throw KeyError("Element with key '" + key + "' already exists");
+  }
+
+  MapIndex* map_index = find_mutable_map_index(parent);
+  if (map_index) {
+    erase_indexed_node(*map_index, node);
+  }
+  nodes.mut(node).key = intern_key(key);
+  if (map_index) {
+    map_index->emplace(key_hash(key), node);
+  }
+}
+
+void Tree::release_refs() {
+  nodes.release_refs();
+  strings.release_refs();
+  binaries.release_refs();
 }
 
-int Tree::emplace_node(const value_t& value, const std::string& key, int parent, int prev) {
+int Tree::emplace_node(int key, int parent, int prev) {
   int index = 0;
   if (free.empty()) {
     index = nodes.size();
-    nodes.emplace_back(value, key, parent, prev);
+    nodes.push_back(Node());
   } else {
     index = free.back();
     free.pop_back();
-    nodes[index] = Node(value, key, parent, prev);
   }
+  Node& node = nodes.mut(index);
+  node.type = NodeType::Null;
+  node.key = key;
+  node.parent = parent;
+  node.child = -1;
+  node.last_child = -1;
+  node.child_count = 0;
+  node.prev = prev;
+  node.next = -1;
   return index;
 }
 
+void Tree::link_node(int node) {
+  int parent = nodes[node].parent;
+  int prev = nodes[node].prev;
+
+  if (prev != -1) {
+    nodes.mut(node).next = nodes[prev].next;
+    nodes.mut(prev).next = node;
+  } else if (parent != -1) {
+    nodes.mut(node).next = nodes[parent].child;
+    nodes.mut(parent).child = node;
+  }
+
+  int next = nodes[node].next;
+  if (next != -1) {
+    nodes.mut(next).prev = node;
+  }
+
+  if (parent == -1) {
+    return;
+  }
+  Node& parent_node = nodes.mut(parent);
+  if (next == -1) {
+    parent_node.last_child = node;
+  }
+  parent_node.child_count++;
+
+  if (MapIndex* map_index = find_mutable_map_index(parent)) {
+    map_index->emplace(key_hash(key(node)), node);
+  }
+  if (find_list_index(parent)) {
+    if (next == -1) {
+      find_mutable_list_index(parent)->push_back(node);
+    } else {
+      list_indexes.erase(parent);
+    }
+  }
+}
+
 void Tree::pop_node(int index) {
+  release_value(index);
+  if (!map_indexes.empty()) {
+    map_indexes.erase(index);
+  }
+  if (!list_indexes.empty()) {
+    list_indexes.erase(index);
+  }
   free.push_back(index);
 }
 
+void Tree::set_value(int index, value_t&& value) {
+  release_value(index);
+  Node& node = nodes.mut(index);
+  node.type = NodeType(value.index());
+
+  if (auto number = std::get_if<number_t>(&value)) {
+    node.number = *number;
+  } else if (auto boolean = std::get_if<bool>(&value)) {
+    node.boolean = *boolean;
+  } else if (auto string = std::get_if<std::string>(&value)) {
+    node.data = store_string(std::move(*string));
+  } else if (auto binary = std::get_if<binary_t>(&value)) {
+    node.data = store_binary(std::move(*binary));
+  }
+}
+
+void Tree::copy_value(int index, const Tree& tree_from, int from) {
+  release_value(index);
+  const Node& node_from = tree_from[from];
+  Node& node = nodes.mut(index);
+  node.type = node_from.type;
+
+  switch (node_from.type) {
+  case NodeType::Number:
+    node.number = node_from.number;
+    break;
+  case NodeType::Boolean:
+    node.boolean = node_from.boolean;
+    break;
+  case NodeType::String:
+    node.data = store_string(std::string(tree_from.strings[node_from.data]));
+    break;
+  case NodeType::Binary:
+    node.data = store_binary(binary_t(tree_from.binaries[node_from.data]));
+    break;
+  default:
+    break;
+  }
+}
+
+void Tree::release_value(int index) {
+  const Node& node = nodes[index];
+  if (node.type == NodeType::String) {
+    std::string().swap(strings.mut(node.data));
+    free_strings.push_back(node.data);
+  } else if (node.type == NodeType::Binary) {
+    binary_t().swap(binaries.mut(node.data));
+    free_binaries.push_back(node.data);
+  } else if (node.type == NodeType::Null) {
+    return;
+  }
+  nodes.mut(index).type = NodeType::Null;
+}
+
+int Tree::store_string(std::string&& string) {
+  if (free_strings.empty()) {
+    strings.push_back(std::move(string));
+    return strings.size() - 1;
+  }
+  int index = free_strings.back();
+  free_strings.pop_back();
+  strings.mut(index) = std::move(string);
+  return index;
+}
+
+int Tree::store_binary(binary_t&& binary) {
+  if (free_binaries.empty()) {
+    binaries.push_back(std::move(binary));
+    return binaries.size() - 1;
+  }
+  int index = free_binaries.back();
+  free_binaries.pop_back();
+  binaries.mut(index) = std::move(binary);
+  return index;
+}
+
+Tree::KeyTable& Tree::mutable_key_table() {
+  if (key_table.use_count() > 1) {
+    key_table = std::make_shared<KeyTable>(*key_table);
+  }
+  return *key_table;
+}
+
+void Tree::compact_keys() {
+  auto table = std::make_shared<KeyTable>();
+  table->keys.emplace_back();
+  std::vector<int> remap(key_table->keys.size(), -1);
+  remap[0] = 0;
+
+  std::stack<int> stack;
+  stack.push(0);
+  while (!stack.empty()) {
+    int node = stack.top();
+    stack.pop();
+    int key = nodes[node].key;
+    if (remap[key] == -1) {
+      remap[key] = table->keys.size();
+      table->keys.push_back(key_table->keys[key]);
+      table->key_ids.emplace(table->keys.back(), remap[key]);
+    }
+    if (remap[key] != key) {
+      nodes.mut(node).key = remap[key];
+    }
+    for (int child = nodes[node].child; child != -1; child = nodes[child].next) {
+      stack.push(child);
+    }
+  }
+
+  key_table = std::move(table);
+}
+
+void Tree::compact_unused_keys() {
+  // Each node uses at most one key, so if there are twice as many keys as nodes, at least half
+  // of the keys are unused
+  const std::size_t keys = key_table->keys.size();
+  if (keys >= compact_min_nodes && keys > 2 * size() && !nodes.empty()) {
+    compact_keys();
+  }
+}
+
+int Tree::intern_key(const std::string& key) {
+  if (key.empty()) {
+    return 0;
+  }
+  auto iter = key_table->key_ids.find(key);
+  if (iter != key_table->key_ids.end()) {
+    return iter->second;
+  }
+  KeyTable& table = mutable_key_table();
+  int id = table.keys.size();
+  table.keys.push_back(key);
+  table.key_ids.emplace(table.keys[id], id);
+  return id;
+}
+
+int Tree::copy_key(const Tree& tree_from, int from) {
+  if (&tree_from == this) {
+    return tree_from[from].key;
+  }
+  return intern_key(tree_from.key(from));
+}
+
+const Tree::MapIndex* Tree::find_map_index(int root) const {
+  if (map_indexes.empty()) {
+    return nullptr;
+  }
+  auto iter = map_indexes.find(root);
+  return iter != map_indexes.end() ? iter->second.get() : nullptr;
+}
+
+Tree::MapIndex* Tree::find_mutable_map_index(int root) {
+  if (map_indexes.empty()) {
+    return nullptr;
+  }
+  auto iter = map_indexes.find(root);
+  if (iter == map_indexes.end()) {
+    return nullptr;
+  }
+  if (iter->second.use_count() > 1) {
+    iter->second = std::make_shared<MapIndex>(*iter->second);
+  }
+  return iter->second.get();
+}
+
+int Tree::find_indexed_node(const MapIndex& map_index, const std::string& key) const {
+  auto [begin, end] = map_index.equal_range(key_hash(key));
+  for (auto iter = begin; iter != end; iter++) {
+    if (this->key(iter->second) == key) {
+      return iter->second;
+    }
+  }
+  return -1;
+}
+
+void Tree::erase_indexed_node(MapIndex& map_index, int node) const {
+  auto [begin, end] = map_index.equal_range(key_hash(key(node)));
+  for (auto iter = begin; iter != end; iter++) {
+    if (iter->second == node) {
+      map_index.erase(iter);
+      return;
+    }
+  }
+}
+
+void Tree::create_map_index(int root) {
+  auto map_index = std::make_shared<MapIndex>();
+  for (int node = nodes[root].child; node != -1; node = nodes[node].next) {
+    map_index->emplace(key_hash(key(node)), node);
+  }
+  map_indexes[root] = std::move(map_index);
+}
+
+const Tree::ListIndex* Tree::find_list_index(int root) const {
+  if (list_indexes.empty()) {
+    return nullptr;
+  }
+  auto iter = list_indexes.find(root);
+  return iter != list_indexes.end() ? iter->second.get() : nullptr;
+}
+
+Tree::ListIndex* Tree::find_mutable_list_index(int root) {
+  if (list_indexes.empty()) {
+    return nullptr;
+  }
+  auto iter = list_indexes.find(root);
+  if (iter == list_indexes.end()) {
+    return nullptr;
+  }
+  if (iter->second.use_count() > 1) {
+    iter->second = std::make_shared<ListIndex>(*iter->second);
+  }
+  return iter->second.get();
+}
+
+void Tree::create_list_index(int root) {
+  auto list_index = std::make_shared<ListIndex>();
+  for (int node = nodes[root].child; node != -1; node = nodes[node].next) {
+    list_index->push_back(node);
+  }
+  list_indexes[root] = std::move(list_index);
+}
+
 } // namespace dpack::object
@@ -1,5 +1,4 @@
 #include "datapack/object.hpp"
-#include <cstring>
 
 namespace dpack {
 
@@ -46,9 +45,7 @@ void ObjectWriter::enumerate(int value, const std::span<const char*>& labels) {
 }
 
 void ObjectWriter::binary(const std::span<const std::uint8_t>& data) {
-  std::vector<std::uint8_t> bytes(data.size());
-  std::memcpy(bytes.data(), data.data(), data.size());
-  *node = bytes;
+  *node = object::binary_t(data.begin(), data.end());
 }
 
 void ObjectWriter::optional_begin(bool has_value) {
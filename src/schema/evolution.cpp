@@ -0,0 +1,435 @@
+#include "datapack/schema/evolution.hpp"
+#include "program.hpp"
+#include <cstring>
+
+namespace dpack {
+
+// Used to skip values which aren't read
+class SkipWriter final : public Writer {
+public:
+  void number(NumberType type, const void* value) override {}
+  void boolean(bool value) override {}
+  void string(const char* string) override {}
+  void enumerate(int value, const std::span<const char*>& labels) override {}
+  void binary(const std::span<const std::uint8_t>& data) override {}
+
+  void optional_begin(bool has_value) override {}
+  void optional_end() override {}
+
+  void variant_begin(int value, const std::span<const char*>& labels) override {}
+  void variant_end() override {}
+
+  void object_begin() override {}
+  void object_next(const char* key) override {}
+  void object_end() override {}
+
+  void tuple_begin() override {}
+  void tuple_next() override {}
+  void tuple_end() override {}
+
+  void list_begin(size_t size) override {}
+  void list_next() override {}
+  void list_end() override {}
+
+  void list_numbers(NumberType type, const void* data, std::size_t size) override {}
+  void tuple_numbers(NumberType type, const void* data, std::size_t size) override {}
+};
+
+static bool is_floating(NumberType type) {
+  return type == NumberType::F32 || type == NumberType::F64;
+}
+
+template <typename T>
+static T load_number(NumberType type, const void* value) {
+  switch (type) {
+  case NumberType::I32:
+    return T(*(const std::int32_t*)value);
+  case NumberType::I64:
+    return T(*(const std::int64_t*)value);
+  case NumberType::U32:
+    return T(*(const std::uint32_t*)value);
+  case NumberType::U64:
+    return T(*(const std::uint64_t*)value);
+  case NumberType::U8:
+    return T(*(const std::uint8_t*)value);
+  case NumberType::F32:
+    return T(*(const float*)value);
+  case NumberType::F64:
+    return T(*(const double*)value);
+  }
+  return T();
+}
+
+template <typename T>
+static void store_number(NumberType type, T value, void* value_out) {
+  switch (type) {
+  case NumberType::I32:
+    *(std::int32_t*)value_out = value;
+    break;
+  case NumberType::I64:
+    *(std::int64_t*)value_out = value;
+    break;
+  case NumberType::U32:
+    *(std::uint32_t*)value_out = value;
+    break;
+  case NumberType::U64:
+    *(std::uint64_t*)value_out = value;
+    break;
+  case NumberType::U8:
+    *(std::uint8_t*)value_out = value;
+    break;
+  case NumberType::F32:
+    *(float*)value_out = value;
+    break;
+  case NumberType::F64:
+    *(double*)value_out = value;
+    break;
+  }
+}
+
+// Index of the label in the new labels, or -1 if it isn't there
+static int find_label(
+    const std::span<const char*>& labels_in,
+    int value,
+    const std::span<const char*>& labels_out) {
+  if (value < 0 || std::size_t(value) >= labels_in.size()) {
+    return -1;
+  }
+  for (std::size_t i = 0; i < labels_out.size(); i++) {
+    if (std::strcmp(labels_in[value], labels_out[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+SchemaEvolutionReader::SchemaEvolutionReader(
+    const Schema& schema,
+    const std::span<const std::uint8_t>& data) :
+    program(schema.program.get()),
+    data(data),
+    reader(std::in_place, data),
+    reader_begin(0),
+    token(0) {
+  if (!program) {
+    invalidate();
+    return;
+  }
+  if (!program->error.empty()) {
+    throw SchemaError(program->error);
+  }
+  token = value_token(0);
+}
+
+void SchemaEvolutionReader::number(NumberType type, void* value) {
+  if (skipping()) {
+    return;
+  }
+  const auto& instruction = program->code[token];
+  if (instruction.op != Program::Op::Number) {
+    invalidate();
+    return;
+  }
+  if (instruction.number_type == type) {
+    reader->number(type, value);
+    return;
+  }
+  alignas(8) std::uint8_t buffer[8];
+  reader->number(instruction.number_type, buffer);
+  if (is_floating(instruction.number_type) || is_floating(type)) {
+    store_number(type, load_number<double>(instruction.number_type, buffer), value);
+  } else {
+    store_number(type, load_number<std::int64_t>(instruction.number_type, buffer), value);
+  }
+}
+
+bool SchemaEvolutionReader::boolean() {
+  if (skipping()) {
+    return false;
+  }
+  if (program->code[token].op != Program::Op::Boolean) {
+    invalidate();
+    return false;
+  }
+  return reader->boolean();
+}
+
+const char* SchemaEvolutionReader::string() {
+  if (skipping()) {
+    return nullptr;
+  }
+  if (program->code[token].op != Program::Op::String) {
+    invalidate();
+    return nullptr;
+  }
+  return reader->string();
+}
+
+int SchemaEvolutionReader::enumerate(const std::span<const char*>& labels) {
+  if (skipping()) {
+    return 0;
+  }
+  const auto& instruction = program->code[token];
+  if (instruction.op != Program::Op::Enumerate) {
+    invalidate();
+    return 0;
+  }
+  int value = find_label(instruction.labels, reader->enumerate(instruction.labels), labels);
+  if (value < 0) {
+    invalidate();
+    return 0;
+  }
+  return value;
+}
+
+std::span<const std::uint8_t> SchemaEvolutionReader::binary() {
+  if (skipping()) {
+    return std::span<const std::uint8_t>();
+  }
+  if (program->code[token].op != Program::Op::Binary) {
+    invalidate();
+    return std::span<const std::uint8_t>();
+  }
+  return reader->binary();
+}
+
+bool SchemaEvolutionReader::optional_begin() {
+  if (skipping()) {
+    return false;
+  }
+  if (program->code[token].op != Program::Op::Optional) {
+    // The value has become optional
+    return true;
+  }
+  bool has_value = reader->optional_begin();
+  token = value_token(token + 1);
+  return has_value;
+}
+
+int SchemaEvolutionReader::variant_begin(const std::span<const char*>& labels) {
+  if (skipping()) {
+    return 0;
+  }
+  const auto& instruction = program->code[token];
+  if (instruction.op != Program::Op::VariantBegin) {
+    invalidate();
+    return 0;
+  }
+  int value_in = reader->variant_begin(instruction.labels);
+  int value = find_label(instruction.labels, value_in, labels);
+  if (value < 0 || std::size_t(value_in) >= instruction.bodies.size() ||
+      instruction.bodies[value_in] == 0) {
+    invalidate();
+    return 0;
+  }
+  token = value_token(instruction.bodies[value_in]);
+  return value;
+}
+
+void SchemaEvolutionReader::object_begin() {
+  if (skipping()) {
+    frames.push_back(Frame{FrameType::Missing});
+    return;
+  }
+  if (program->code[token].op != Program::Op::ObjectBegin) {
+    invalidate();
+    frames.push_back(Frame{FrameType::Missing});
+    return;
+  }
+  frames.push_back(Frame{FrameType::Object, token + 1, token + 1, pos()});
+}
+
+bool SchemaEvolutionReader::object_next(const char* key) {
+  using Op = Program::Op;
+  Frame& frame = frames.back();
+  if (frame.type != FrameType::Object || !valid()) {
+    return true;
+  }
+  frame.member_missing = false;
+  const auto& code = program->code;
+
+  // Usually members are read in the order they were written, so check the next member first
+  std::uint32_t member = frame.token;
+  if (code[member].op != Op::ObjectNext || std::strcmp(code[member].key, key) != 0) {
+    member = frame.begin_token;
+    while (code[member].op == Op::ObjectNext && std::strcmp(code[member].key, key) != 0) {
+      member = code[member].end;
+    }
+    if (code[member].op != Op::ObjectNext) {
+      // Added since the data was written, so isn't read and keeps its default value
+      frame.member_missing = true;
+      return false;
+    }
+  }
+
+  if (frame.members.empty() && member >= frame.token) {
+    // Skip any members that were removed
+    skip_members(frame.token, member);
+    frame.token = code[member].end;
+  } else {
+    // Read out of order, so find where each member is
+    if (frame.members.empty()) {
+      index_members(frame);
+    }
+    for (const auto& [index, position] : frame.members) {
+      if (index == member) {
+        seek(position);
+        break;
+      }
+    }
+  }
+  token = value_token(member + 1);
+  return true;
+}
+
+void SchemaEvolutionReader::object_end() {
+  Frame& frame = frames.back();
+  if (frame.type == FrameType::Object && valid()) {
+    if (frame.members.empty()) {
+      skip_members(frame.token, program->code[frame.begin_token - 1].end - 1);
+    } else {
+      seek(frame.end);
+    }
+  }
+  frames.pop_back();
+}
+
+void SchemaEvolutionReader::tuple_begin() {
+  if (skipping()) {
+    frames.push_back(Frame{FrameType::Missing});
+    return;
+  }
+  if (program->code[token].op != Program::Op::TupleBegin) {
+    invalidate();
+    frames.push_back(Frame{FrameType::Missing});
+    return;
+  }
+  frames.push_back(Frame{FrameType::Tuple, token + 1, token + 1});
+}
+
+void SchemaEvolutionReader::tuple_next() {
+  Frame& frame = frames.back();
+  if (frame.type != FrameType::Tuple || !valid()) {
+    return;
+  }
+  const auto& code = program->code;
+  frame.member_missing = code[frame.token].op != Program::Op::TupleNext;
+  if (!frame.member_missing) {
+    token = value_token(frame.token + 1);
+    frame.token = code[frame.token].end;
+  }
+}
+
+void SchemaEvolutionReader::tuple_end() {
+  Frame& frame = frames.back();
+  if (frame.type == FrameType::Tuple && valid()) {
+    skip_members(frame.token, program->code[frame.begin_token - 1].end - 1);
+  }
+  frames.pop_back();
+}
+
+size_t SchemaEvolutionReader::list_begin() {
+  if (skipping()) {
+    frames.push_back(Frame{FrameType::Missing});
+    return 0;
+  }
+  if (program->code[token].op != Program::Op::List) {
+    invalidate();
+    frames.push_back(Frame{FrameType::Missing});
+    return 0;
+  }
+  frames.push_back(Frame{FrameType::List, value_token(token + 1)});
+  return reader->list_begin();
+}
+
+void SchemaEvolutionReader::list_next() {
+  if (frames.back().type == FrameType::List) {
+    token = frames.back().token;
+  }
+}
+
+void SchemaEvolutionReader::list_end() {
+  frames.pop_back();
+}
+
+void SchemaEvolutionReader::list_numbers(NumberType type, void* data, std::size_t size) {
+  if (same_numbers(type)) {
+    reader->list_numbers(type, data, size);
+    return;
+  }
+  Reader::list_numbers(type, data, size);
+}
+
+const void* SchemaEvolutionReader::borrow_numbers(NumberType type, std::size_t size) {
+  if (same_numbers(type)) {
+    return reader->borrow_numbers(type, size);
+  }
+  return nullptr;
+}
+
+// Reads are skipped if the value isn't in the data, or the reader is invalid
+bool SchemaEvolutionReader::skipping() {
+  if (!reader->valid()) {
+    invalidate();
+  }
+  if (!valid()) {
+    return true;
+  }
+  return !frames.empty() &&
+         (frames.back().type == FrameType::Missing || frames.back().member_missing);
+}
+
+// If reading a list of numbers of the same type, so they can be read together
+bool SchemaEvolutionReader::same_numbers(NumberType type) {
+  if (skipping() || frames.back().type != FrameType::List) {
+    return false;
+  }
+  const auto& element = program->code[frames.back().token];
+  return element.op == Program::Op::Number && element.number_type == type;
+}
+
+void SchemaEvolutionReader::skip(std::uint32_t token) {
+  SkipWriter writer;
+  program->run(*reader, writer, token, program->code[token].end);
+}
+
+// Skips the members of an object or tuple, from the member token begin up to end
+void SchemaEvolutionReader::skip_members(std::uint32_t begin, std::uint32_t end) {
+  for (std::uint32_t member = begin; member != end; member = program->code[member].end) {
+    skip(member + 1);
+  }
+}
+
+void SchemaEvolutionReader::index_members(Frame& frame) {
+  const auto& code = program->code;
+  seek(frame.begin);
+  for (std::uint32_t member = frame.begin_token; code[member].op == Program::Op::ObjectNext;
+       member = code[member].end) {
+    frame.members.emplace_back(member, pos());
+    skip(member + 1);
+  }
+  frame.end = pos();
+}
+
+// Skips any hint or description tokens before a value
+std::uint32_t SchemaEvolutionReader::value_token(std::uint32_t token) const {
+  const auto& code = program->code;
+  while (code[token].op == Program::Op::Hint || code[token].op == Program::Op::Description) {
+    token++;
+  }
+  return token;
+}
+
+std::size_t SchemaEvolutionReader::pos() const {
+  return reader_begin + reader->pos();
+}
+
+void SchemaEvolutionReader::seek(std::size_t pos) {
+  if (!reader->valid()) {
+    invalidate();
+  }
+  reader.emplace(data.subspan(pos));
+  reader_begin = pos;
+}
+
+} // namespace dpack
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "datapack/schema/schema.hpp"
+#include <span>
+
+namespace dpack {
+
+// The schema compiled into a flat program, with one instruction per token. Each instruction
+// holds what it needs from its token, and where the value starting at it ends, so apply()
+// neither dispatches on the token variant nor searches for the end of a value.
+struct Schema::Program {
+  // Alternatives of Token, in the same order
+  enum class Op : std::uint8_t {
+    Number,
+    Boolean,
+    String,
+    Enumerate,
+    Binary,
+    Optional,
+    VariantBegin,
+    VariantNext,
+    VariantEnd,
+    ObjectBegin,
+    ObjectNext,
+    ObjectEnd,
+    TupleBegin,
+    TupleNext,
+    TupleEnd,
+    List,
+    Hint,
+    Description
+  };
+
+  struct Instruction {
+    Op op;
+    NumberType number_type;                   // Number
+    bool list_numbers = false;                // List, if the elements are numbers
+    std::uint32_t end = 0;                    // Index after the value starting here
+    const char* key = nullptr;                // ObjectNext
+    std::span<const char*> labels;            // Enumerate, VariantBegin
+    std::span<const std::uint32_t> bodies;    // VariantBegin, start of each body (0 if none)
+    const Hint* hint = nullptr;               // Hint
+    const std::string* description = nullptr; // Description
+  };
+
+  Program(const std::vector<Token>& tokens);
+  std::uint32_t compile_value(std::uint32_t index, std::size_t depth);
+  void find_skip_ends();
+  // Converts the values starting at begin, up to end
+  void run(Reader& reader, Writer& writer, std::uint32_t begin, std::uint32_t end) const;
+
+  std::vector<Token> tokens; // Copied, since the instructions refer to them
+  std::vector<std::vector<const char*>> labels;
+  std::vector<std::vector<std::uint32_t>> bodies;
+  std::vector<Instruction> code;
+  // Result of Schema::Iterator::skip() for each token. Unlike Instruction::end, this is also
+  // defined if the tokens aren't valid.
+  std::vector<std::uint32_t> skip_ends;
+  std::size_t max_depth = 0; // Of nested lists, optionals and variants
+  std::string error;         // Thrown by run(), if the tokens aren't valid
+};
+
+} // namespace dpack
@@ -1,10 +1,9 @@
 #include "datapack/schema/schema.hpp"
+#include "program.hpp"
 #include "datapack/std/string.hpp"
 #include "datapack/std/variant.hpp"
 #include "datapack/std/vector.hpp"
-#include <assert.h>
-
-#include <stack>
+#include <algorithm>
 
 namespace dpack {
 
@@ -13,240 +12,353 @@ Schema::Iterator Schema::Iterator::next() const {
 }
 
 Schema::Iterator Schema::Iterator::skip() const {
-  int depth = 0;
-  std::size_t skip_index = index;
-  bool at_start = false;
-  while (skip_index < schema->tokens.size()) {
-    const auto& token = schema->tokens[skip_index];
-    bool is_wrapper = false;
-    if (std::get_if<token::ObjectBegin>(&token)) {
-      depth++;
-    } else if (std::get_if<token::ObjectEnd>(&token)) {
-      depth--;
-    } else if (std::get_if<token::TupleBegin>(&token)) {
-      depth++;
-    } else if (std::get_if<token::TupleEnd>(&token)) {
-      depth--;
-    } else if (std::get_if<token::VariantBegin>(&token)) {
-      depth++;
-    } else if (std::get_if<token::VariantEnd>(&token)) {
-      depth--;
-    } else if (std::get_if<token::List>(&token)) {
-      is_wrapper = true;
-    } else if (std::get_if<token::Optional>(&token)) {
-      is_wrapper = true;
-    }
-    skip_index++;
+  if (index >= schema->tokens.size()) {
+    return *this;
+  }
+  return Iterator(schema, schema->program->skip_ends[index]);
+}
 
-    if (depth == 0 && is_wrapper) {
-      continue;
-    }
-    bool composite = false;
-    if (at_start) {
+Schema::Program::Program(const std::vector<Token>& tokens) : tokens(tokens) {
+  auto make_labels = [this](const std::vector<std::string>& strings) {
+    auto& result = labels.emplace_back();
+    for (const auto& string : strings) {
+      result.push_back(string.c_str());
     }
-    if (depth == 0 && !(at_start && is_wrapper)) {
-      break;
+    return std::span<const char*>(result);
+  };
+
+  code.resize(this->tokens.size());
+  for (std::size_t i = 0; i < code.size(); i++) {
+    const Token& token = this->tokens[i];
+    Instruction& instruction = code[i];
+    instruction.op = Op(token.index());
+    if (auto number = std::get_if<token::Number>(&token)) {
+      instruction.number_type = number->type;
+    } else if (auto enumerate = std::get_if<token::Enumerate>(&token)) {
+      instruction.labels = make_labels(enumerate->labels);
+    } else if (auto variant_begin = std::get_if<token::VariantBegin>(&token)) {
+      instruction.labels = make_labels(variant_begin->labels);
+    } else if (auto object_next = std::get_if<token::ObjectNext>(&token)) {
+      instruction.key = object_next->key.c_str();
+    } else if (auto hint = std::get_if<token::Hint>(&token)) {
+      instruction.hint = &hint->hint;
+    } else if (auto description = std::get_if<token::Description>(&token)) {
+      instruction.description = &description->description;
     }
-    if (depth > 0) {
-      at_start = false;
+  }
+
+  find_skip_ends();
+
+  try {
+    std::uint32_t index = 0;
+    while (index < code.size()) {
+      index = compile_value(index, 0);
     }
+  } catch (const SchemaError& e) {
+    error = e.what();
   }
-  return Iterator(schema, skip_index);
 }
 
-void Schema::apply(Reader& reader, Writer& writer) const {
-  std::stack<Iterator> stack;
-  std::stack<size_t> list_remaining;
-
-  for (auto iter = begin(); iter != end(); iter = iter.next()) {
-    while (!stack.empty()) {
-      auto parent = stack.top();
-      if (parent.object_begin()) {
-        if (iter.object_end()) {
-          reader.object_end();
-          writer.object_end();
-          stack.pop();
-          iter = iter.next();
-          continue;
-        }
-        auto object_next = iter.object_next();
-        if (!object_next) {
-          throw SchemaError("Expected ObjectNext token");
-        }
-        reader.object_next(object_next->key.c_str());
-        writer.object_next(object_next->key.c_str());
+std::uint32_t Schema::Program::compile_value(std::uint32_t index, std::size_t depth) {
+  if (index >= code.size()) {
+    throw SchemaError("Expected a value");
+  }
+  Instruction& instruction = code[index];
 
-        iter = iter.next();
-        if (iter == end()) {
-          throw SchemaError("Expected a valid token after ObjectNext");
-        }
-        break;
+  switch (instruction.op) {
+  case Op::Number:
+  case Op::Boolean:
+  case Op::String:
+  case Op::Enumerate:
+  case Op::Binary:
+    instruction.end = index + 1;
+    break;
+  case Op::Hint:
+  case Op::Description:
+    // Annotations of the value that follows
+    instruction.end = compile_value(index + 1, depth);
+    break;
+  case Op::Optional:
+  case Op::List:
+    max_depth = std::max(max_depth, depth + 1);
+    instruction.end = compile_value(index + 1, depth + 1);
+    instruction.list_numbers = instruction.op == Op::List && instruction.end == index + 2 &&
+                               code[index + 1].op == Op::Number;
+    break;
+  case Op::ObjectBegin:
+  case Op::TupleBegin: {
+    const Op next_op = instruction.op == Op::ObjectBegin ? Op::ObjectNext : Op::TupleNext;
+    const Op end_op = instruction.op == Op::ObjectBegin ? Op::ObjectEnd : Op::TupleEnd;
+    std::uint32_t next = index + 1;
+    while (next < code.size() && code[next].op == next_op) {
+      next = code[next].end = compile_value(next + 1, depth);
+    }
+    if (next >= code.size() || code[next].op != end_op) {
+      throw SchemaError(
+          instruction.op == Op::ObjectBegin ? "Expected ObjectNext token"
+                                            : "Expected TupleNext token");
+    }
+    instruction.end = next + 1;
+    break;
+  }
+  case Op::VariantBegin: {
+    max_depth = std::max(max_depth, depth + 1);
+    // Bodies may contain variants of their own, which add to "bodies", so build this list
+    // separately. Moving it into "bodies" keeps the span below valid.
+    std::vector<std::uint32_t> variant_bodies;
+    std::uint32_t next = index + 1;
+    while (next < code.size() && code[next].op == Op::VariantNext) {
+      int choice = std::get<token::VariantNext>(tokens[next]).index;
+      if (choice < 0) {
+        throw SchemaError("Invalid VariantNext index");
       }
-
-      if (parent.tuple_begin()) {
-        if (iter.tuple_end()) {
-          reader.tuple_end();
-          writer.tuple_end();
-          stack.pop();
-          iter = iter.next();
-          continue;
-        }
-        if (!iter.tuple_next()) {
-          throw SchemaError("Expected TupleNext token");
-        }
-        reader.tuple_next();
-        writer.tuple_next();
-
-        iter = iter.next();
-        if (iter == end()) {
-          throw SchemaError("Expected a valid token after TupleNext");
-        }
-        break;
+      if (std::size_t(choice) >= variant_bodies.size()) {
+        variant_bodies.resize(choice + 1, 0);
       }
+      variant_bodies[choice] = next + 1;
+      next = code[next].end = compile_value(next + 1, depth + 1);
+    }
+    if (next >= code.size() || code[next].op != Op::VariantEnd) {
+      throw SchemaError("Expected VariantNext");
+    }
+    instruction.bodies = bodies.emplace_back(std::move(variant_bodies));
+    instruction.end = next + 1;
+    break;
+  }
+  default:
+    throw SchemaError("Unexpected token");
+  }
+  return instruction.end;
+}
 
-      if (parent.list()) {
-        if (list_remaining.empty()) {
-          throw std::runtime_error("Shouldn't happen");
-        }
-        if (list_remaining.top() == 0) {
-          reader.list_end();
-          writer.list_end();
-          list_remaining.pop();
-          stack.pop();
-          continue;
-        }
-        list_remaining.top()--;
-        reader.list_next();
-        writer.list_next();
-        iter = parent.next();
-        break;
+void Schema::Program::find_skip_ends() {
+  // Begin tokens skip to after their matching end token, while lists and optionals also skip
+  // the value they contain, which is only known after a backwards pass. Anything else skips to
+  // the next token.
+  skip_ends.resize(code.size());
+  std::vector<std::uint32_t> begins;
+  for (std::uint32_t i = 0; i < code.size(); i++) {
+    skip_ends[i] = i + 1;
+    switch (code[i].op) {
+    case Op::ObjectBegin:
+    case Op::TupleBegin:
+    case Op::VariantBegin:
+      begins.push_back(i);
+      break;
+    case Op::ObjectEnd:
+    case Op::TupleEnd:
+    case Op::VariantEnd:
+      if (!begins.empty()) {
+        skip_ends[begins.back()] = i + 1;
+        begins.pop_back();
       }
+      break;
+    default:
+      break;
+    }
+  }
+  // Unmatched begin tokens extend to the end
+  for (std::uint32_t begin : begins) {
+    skip_ends[begin] = code.size();
+  }
+  for (std::uint32_t i = code.size(); i-- > 0;) {
+    if (code[i].op == Op::List || code[i].op == Op::Optional) {
+      skip_ends[i] = i + 1 < code.size() ? skip_ends[i + 1] : code.size();
+    }
+  }
+}
 
-      if (parent.optional()) {
-        if (iter != parent.next()) {
-          assert(iter == parent.skip());
-          reader.optional_end();
-          writer.optional_end();
-          stack.pop();
-          continue;
-        }
-        break;
-      }
+void Schema::Program::run(
+    Reader& reader,
+    Writer& writer,
+    std::uint32_t begin,
+    std::uint32_t end) const {
+  if (!error.empty()) {
+    throw SchemaError(error);
+  }
+
+  // Lists, optionals and variants that are being read, whose bodies end at "end"
+  struct Frame {
+    Op op;
+    std::uint32_t end;
+    std::uint32_t body;   // List: start of an element
+    std::uint32_t resume; // Variant: where to continue after the body
+    std::size_t remaining;
+  };
+  static constexpr std::size_t local_depth = 32;
+  Frame local_frames[local_depth];
+  std::vector<Frame> heap_frames;
+  Frame* frames = local_frames;
+  if (max_depth > local_depth) {
+    heap_frames.resize(max_depth);
+    frames = heap_frames.data();
+  }
+  std::size_t depth = 0;
+  std::vector<std::uint8_t> numbers; // For lists of numbers the reader can't lend
 
-      if (parent.variant_next()) {
-        if (iter != parent.next()) {
-          while (iter != end()) {
-            if (iter.variant_end()) {
-              break;
-            }
-            if (!iter.variant_next()) {
-              throw SchemaError("Expected VariantNext");
-            }
-            iter = iter.next().skip();
-          }
-          reader.variant_end();
-          writer.variant_end();
-          stack.pop();
-          iter = iter.next();
+  std::uint32_t index = begin;
+  while (true) {
+    while (depth > 0 && index == frames[depth - 1].end) {
+      Frame& frame = frames[depth - 1];
+      if (frame.op == Op::List) {
+        if (frame.remaining > 0) {
+          frame.remaining--;
+          reader.list_next();
+          writer.list_next();
+          index = frame.body;
           continue;
         }
-        break;
+        reader.list_end();
+        writer.list_end();
+      } else if (frame.op == Op::Optional) {
+        reader.optional_end();
+        writer.optional_end();
+      } else {
+        reader.variant_end();
+        writer.variant_end();
+        index = frame.resume;
       }
-      assert(false);
+      depth--;
     }
-    if (iter == end()) {
+    if (index >= end) {
       break;
     }
 
-    if (iter.object_begin()) {
-      reader.object_begin();
-      writer.object_begin();
-      stack.push(iter);
-      continue;
-    }
-    if (iter.tuple_begin()) {
-      reader.tuple_begin();
-      writer.tuple_begin();
-      stack.push(iter);
-      continue;
+    const Instruction& instruction = code[index];
+    switch (instruction.op) {
+    case Op::Number: {
+      alignas(8) std::uint8_t buffer[8];
+      reader.number(instruction.number_type, buffer);
+      writer.number(instruction.number_type, buffer);
+      index++;
+      break;
     }
-    if (iter.list()) {
-      const size_t size = reader.list_begin();
-      list_remaining.push(size);
-      writer.list_begin(size);
-      stack.push(iter);
-      continue;
+    case Op::Boolean:
+      writer.boolean(reader.boolean());
+      index++;
+      break;
+    case Op::String: {
+      // Readers return null if the value is missing or invalid
+      const char* value = reader.string();
+      writer.string(value ? value : "");
+      index++;
+      break;
     }
-    if (iter.optional()) {
+    case Op::Enumerate:
+      writer.enumerate(reader.enumerate(instruction.labels), instruction.labels);
+      index++;
+      break;
+    case Op::Binary:
+      writer.binary(reader.binary());
+      index++;
+      break;
+    case Op::Optional: {
       bool has_value = reader.optional_begin();
       writer.optional_begin(has_value);
       if (has_value) {
-        stack.push(iter);
+        frames[depth++] = Frame{Op::Optional, instruction.end, 0, 0, 0};
+        index++;
+      } else {
+        index = instruction.end;
       }
-      continue;
+      break;
     }
-    if (auto variant_begin = iter.variant_begin()) {
-      std::vector<const char*> labels_c_str;
-      for (const auto& label : variant_begin->labels) {
-        labels_c_str.push_back(label.c_str());
-      }
-      int choice = reader.variant_begin(labels_c_str);
-      writer.variant_begin(choice, labels_c_str);
-
-      // Don't push VariantBegin
-
-      iter = iter.next();
-      while (iter != end()) {
-        auto variant_next = iter.variant_next();
-        if (!variant_next) {
-          throw SchemaError("Expected VariantNext");
-        }
-        if (variant_next->index == choice) {
-          break;
-        }
-        iter = iter.next().skip();
-      }
-
-      if (iter == end()) {
+    case Op::VariantBegin: {
+      int choice = reader.variant_begin(instruction.labels);
+      writer.variant_begin(choice, instruction.labels);
+      if (choice < 0 || std::size_t(choice) >= instruction.bodies.size() ||
+          instruction.bodies[choice] == 0) {
         throw SchemaError("Failed to find a valid VariantNext token");
       }
-      // Push VariantNext
-      stack.push(iter);
-
-      continue;
-    }
-
-    if (auto number = iter.number()) {
-      char buffer[8];
-      reader.number(number->type, (void*)buffer);
-      writer.number(number->type, (void*)buffer);
-      continue;
-    }
-    if (iter.boolean()) {
-      writer.boolean(reader.boolean());
-      continue;
-    }
-    if (iter.string()) {
-      writer.string(reader.string());
-      continue;
+      std::uint32_t body = instruction.bodies[choice];
+      frames[depth++] = Frame{Op::VariantBegin, code[body - 1].end, 0, instruction.end, 0};
+      index = body;
+      break;
     }
-    if (auto enumerate = iter.enumerate()) {
-      std::vector<const char*> labels_c_str;
-      for (const auto& label : enumerate->labels) {
-        labels_c_str.push_back(label.c_str());
+    case Op::ObjectBegin:
+      reader.object_begin();
+      writer.object_begin();
+      index++;
+      break;
+    case Op::ObjectNext:
+      reader.object_next(instruction.key);
+      writer.object_next(instruction.key);
+      index++;
+      break;
+    case Op::ObjectEnd:
+      reader.object_end();
+      writer.object_end();
+      index++;
+      break;
+    case Op::TupleBegin:
+      reader.tuple_begin();
+      writer.tuple_begin();
+      index++;
+      break;
+    case Op::TupleNext:
+      reader.tuple_next();
+      writer.tuple_next();
+      index++;
+      break;
+    case Op::TupleEnd:
+      reader.tuple_end();
+      writer.tuple_end();
+      index++;
+      break;
+    case Op::List: {
+      std::size_t size = reader.list_begin();
+      writer.list_begin(size);
+      if (instruction.list_numbers && size > 0) {
+        NumberType type = code[index + 1].number_type;
+        const void* data = reader.borrow_numbers(type, size);
+        if (!data) {
+          numbers.resize(size * number_size(type));
+          reader.list_numbers(type, numbers.data(), size);
+          data = numbers.data();
+        }
+        writer.list_numbers(type, data, size);
+        size = 0;
+      }
+      if (size == 0) {
+        reader.list_end();
+        writer.list_end();
+        index = instruction.end;
+        break;
       }
-      writer.enumerate(reader.enumerate(labels_c_str), labels_c_str);
-      continue;
+      frames[depth++] = Frame{Op::List, instruction.end, index + 1, 0, size - 1};
+      reader.list_next();
+      writer.list_next();
+      index++;
+      break;
     }
-    if (iter.binary()) {
-      writer.binary(reader.binary());
-      continue;
+    case Op::Hint:
+      reader.hint(*instruction.hint);
+      writer.hint(*instruction.hint);
+      index++;
+      break;
+    case Op::Description:
+      reader.description(*instruction.description);
+      writer.description(*instruction.description);
+      index++;
+      break;
+    default:
+      // Excluded by compile_value()
+      throw SchemaError("Unexpected token");
     }
+  }
+}
 
-    throw SchemaError("Unexpected token");
+void Schema::apply(Reader& reader, Writer& writer) const {
+  if (program) {
+    program->run(reader, writer, 0, program->code.size());
   }
 }
 
+void Schema::update() {
+  set_hash();
+  program = tokens.empty() ? nullptr : std::make_shared<const Program>(tokens);
+}
+
 void Schema::set_hash() {
   hash_ = 0;
   for (const auto& token : tokens) {
@@ -302,6 +414,11 @@ bool operator==(const Schema& lhs, const Schema& rhs) {
   return true;
 }
 
-DPACK_CLASS_DEF(Schema, tokens)
+DPACK_CLASS_DEF_CUSTOM(Schema, {
+  packer.object_begin();
+  packer.value("tokens", tokens);
+  packer.object_end();
+  update();
+})
 
 } // namespace dpack
@@ -57,8 +57,9 @@ void Tokenizer::object_begin() {
   tokens.push_back(token::ObjectBegin());
 }
 
-void Tokenizer::object_next(const char* key) {
+bool Tokenizer::object_next(const char* key) {
   tokens.push_back(token::ObjectNext(key));
+  return true;
 }
 
 void Tokenizer::object_end() {
@@ -1,6 +1,16 @@
+#include <cstring>
 #include <datapack/binary.hpp>
 #include <datapack/examples/entity.hpp>
+#include <datapack/examples/templated.hpp>
+#include <datapack/object.hpp>
+#include <datapack/std/array.hpp>
+#include <datapack/std/optional.hpp>
+#include <datapack/std/span.hpp>
+#include <datapack/std/string.hpp>
+#include <datapack/std/string_view.hpp>
+#include <datapack/std/vector.hpp>
 #include <gtest/gtest.h>
+#include <sstream>
 
 TEST(Binary, WriteRead) {
   Entity in = Entity::example();
@@ -10,3 +20,298 @@ TEST(Binary, WriteRead) {
 
   ASSERT_EQ(in, out);
 }
+
+TEST(Binary, GrowableWriter) {
+  Entity in = Entity::example();
+  std::vector<std::uint8_t> expected(dpack::binary_size(in));
+  dpack::to_binary(in, std::span<std::uint8_t>(expected));
+
+  std::vector<std::uint8_t> data;
+  dpack::to_binary(in, data);
+  EXPECT_EQ(data, expected);
+
+  // Reusing the buffer overwrites the previous contents and keeps the capacity
+  const std::size_t capacity = data.capacity();
+  dpack::to_binary(in, data);
+  EXPECT_EQ(data, expected);
+  EXPECT_EQ(data.capacity(), capacity);
+
+  EXPECT_EQ(dpack::from_binary<Entity>(data), in);
+}
+
+TEST(Binary, FixedBufferTooSmall) {
+  Entity in = Entity::example();
+  std::vector<std::uint8_t> data(dpack::binary_size(in) - 1);
+  EXPECT_THROW(dpack::to_binary(in, std::span<std::uint8_t>(data)), std::runtime_error);
+}
+
+TEST(Binary, StaticMatchesVirtual) {
+  Entity in = Entity::example();
+  std::vector<std::uint8_t> data_static = dpack::to_binary(in);
+
+  std::vector<std::uint8_t> data_virtual;
+  dpack::BinaryWriter writer(data_virtual);
+  static_cast<dpack::Writer&>(writer).value(in);
+  writer.finish();
+  EXPECT_EQ(data_static, data_virtual);
+
+  Entity out;
+  dpack::BinaryReader reader(data_static);
+  static_cast<dpack::Reader&>(reader).value(out);
+  EXPECT_EQ(in, out);
+
+  Point<double> point_in = {1.0, 2.0};
+  auto point_out = dpack::from_binary<Point<double>>(dpack::to_binary(point_in));
+  EXPECT_EQ(point_out.x, point_in.x);
+  EXPECT_EQ(point_out.y, point_in.y);
+
+  // Non-static packers passed by their concrete type use the virtual overloads
+  dpack::Object object;
+  dpack::ObjectWriter object_writer(object);
+  dpack::write(object_writer, in);
+  EXPECT_EQ(dpack::from_object<Entity>(object), in);
+}
+
+TEST(Binary, NumberArrays) {
+  std::vector<double> vector_in = {1.0, -2.5, 3.25};
+  std::vector<std::uint8_t> data = dpack::to_binary(vector_in);
+
+  std::vector<std::uint8_t> expected(sizeof(std::size_t) + sizeof(double) * vector_in.size());
+  *((std::size_t*)expected.data()) = vector_in.size();
+  std::memcpy(&expected[sizeof(std::size_t)], vector_in.data(), sizeof(double) * vector_in.size());
+  EXPECT_EQ(data, expected);
+  EXPECT_EQ(dpack::binary_size(vector_in), expected.size());
+  EXPECT_EQ(dpack::from_binary<std::vector<double>>(data), vector_in);
+
+  std::array<int, 3> array_in = {1, -2, 3};
+  data = dpack::to_binary(array_in);
+  ASSERT_EQ(data.size(), sizeof(array_in));
+  EXPECT_EQ(std::memcmp(data.data(), array_in.data(), sizeof(array_in)), 0);
+  EXPECT_EQ((dpack::from_binary<std::array<int, 3>>(data)), array_in);
+
+  // Truncated data invalidates the reader rather than reading past the end
+  data = dpack::to_binary(vector_in);
+  data.pop_back();
+  std::vector<double> vector_out;
+  dpack::BinaryReader reader(data);
+  reader.value(vector_out);
+  EXPECT_FALSE(reader.valid());
+}
+
+struct Message {
+  std::vector<double> values;
+  std::string name;
+  std::vector<std::uint8_t> data;
+};
+
+struct MessageView {
+  std::span<const double> values;
+  std::string_view name;
+  std::span<const std::uint8_t> data;
+};
+
+namespace dpack {
+DPACK_INLINE(Message, values, name, data)
+DPACK_INLINE(MessageView, values, name, data)
+} // namespace dpack
+
+TEST(Binary, BorrowedViews) {
+  Message in = {{1.0, 2.0, 3.0}, "message", {0x01, 0x02, 0x03}};
+  std::vector<std::uint8_t> data = dpack::to_binary(in);
+
+  auto in_buffer = [&](const void* ptr) {
+    return ptr >= data.data() && ptr < data.data() + data.size();
+  };
+
+  MessageView view;
+  dpack::BinaryReader reader(data);
+  reader.value(view);
+  ASSERT_TRUE(reader.valid());
+
+  EXPECT_TRUE(std::equal(view.values.begin(), view.values.end(), in.values.begin()));
+  EXPECT_EQ(view.values.size(), in.values.size());
+  EXPECT_EQ(view.name, in.name);
+  EXPECT_TRUE(std::equal(view.data.begin(), view.data.end(), in.data.begin()));
+  EXPECT_EQ(view.data.size(), in.data.size());
+
+  EXPECT_TRUE(in_buffer(view.values.data()));
+  EXPECT_TRUE(in_buffer(view.name.data()));
+  EXPECT_TRUE(in_buffer(view.data.data()));
+
+  // Views write the same data as the owning types
+  EXPECT_EQ(dpack::to_binary(view), data);
+
+  // Misaligned numbers can't be borrowed
+  std::vector<std::uint8_t> offset_data(data.size() + 1);
+  std::memcpy(&offset_data[1], data.data(), data.size());
+  dpack::BinaryReader offset_reader(std::span<const std::uint8_t>(offset_data).subspan(1));
+  offset_reader.value(view);
+  EXPECT_FALSE(offset_reader.valid());
+}
+
+TEST(Binary, CompactFormat) {
+  Entity in = Entity::example();
+  const auto format = dpack::BinaryFormat::Compact;
+
+  std::vector<std::uint8_t> data = dpack::to_binary(in, format);
+  EXPECT_EQ(data.size(), dpack::binary_size(in, format));
+  EXPECT_LT(data.size(), dpack::binary_size(in));
+  EXPECT_EQ(dpack::from_binary<Entity>(data, format), in);
+
+  std::vector<std::int64_t> integers = {0, -1, 1, -64, 64, INT64_MIN, INT64_MAX};
+  data = dpack::to_binary(integers, format);
+  // Length, then zigzag encoded values
+  std::vector<std::uint8_t> expected = {0x07, 0x00, 0x01, 0x02, 0x7f, 0x80, 0x01};
+  expected.insert(expected.end(), 9, 0xff);
+  expected.push_back(0x01);
+  expected.push_back(0xfe);
+  expected.insert(expected.end(), 8, 0xff);
+  expected.push_back(0x01);
+  EXPECT_EQ(data, expected);
+  EXPECT_EQ(dpack::from_binary<std::vector<std::int64_t>>(data, format), integers);
+
+  // Truncated varint invalidates the reader
+  data.pop_back();
+  std::vector<std::int64_t> integers_out;
+  dpack::BinaryReader reader(data, format);
+  reader.value(integers_out);
+  EXPECT_FALSE(reader.valid());
+}
+
+TEST(Binary, Streaming) {
+  std::vector<Entity> in = {Entity::example(), Entity::example()};
+  in[1].sprite.data.resize(100); // Larger than the stream buffer
+  std::vector<std::uint8_t> expected = dpack::to_binary(in);
+
+  // Small buffer to test flushing and refilling
+  std::stringstream stream;
+  std::vector<std::uint8_t> buffer(16);
+  dpack::BinaryWriter writer(stream, buffer);
+  writer.value(in);
+  writer.finish();
+  EXPECT_EQ(writer.pos(), expected.size());
+
+  std::string streamed = stream.str();
+  EXPECT_EQ(std::vector<std::uint8_t>(streamed.begin(), streamed.end()), expected);
+
+  std::vector<Entity> out;
+  dpack::BinaryReader reader(stream, buffer);
+  reader.value(out);
+  EXPECT_TRUE(reader.valid());
+  EXPECT_EQ(out, in);
+
+  // Reading past the end of the stream invalidates the reader
+  std::stringstream truncated(streamed.substr(0, streamed.size() - 1));
+  dpack::BinaryReader truncated_reader(truncated, buffer);
+  truncated_reader.value(out);
+  EXPECT_FALSE(truncated_reader.valid());
+}
+
+TEST(Binary, LittleEndian) {
+  std::vector<std::uint32_t> integers = {0x01020304};
+  std::vector<std::uint8_t> expected = {1, 0, 0, 0, 0, 0, 0, 0, 0x04, 0x03, 0x02, 0x01};
+  EXPECT_EQ(dpack::to_binary(integers), expected);
+  EXPECT_EQ(dpack::from_binary<std::vector<std::uint32_t>>(expected), integers);
+
+  expected = {0, 0, 0, 0, 0, 0, 0xf0, 0x3f};
+  EXPECT_EQ(dpack::to_binary(1.0), expected);
+  EXPECT_EQ(dpack::from_binary<double>(expected), 1.0);
+}
+
+TEST(Binary, AlignedFormat) {
+  const auto format = dpack::BinaryFormat::Aligned;
+
+  // Flag, padding to 8 bytes, then the value
+  std::optional<double> optional = 1.0;
+  std::vector<std::uint8_t> expected = {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xf0, 0x3f};
+  EXPECT_EQ(dpack::to_binary(optional, format), expected);
+  EXPECT_EQ(dpack::from_binary<std::optional<double>>(expected, format), optional);
+
+  Entity in = Entity::example();
+  std::vector<std::uint8_t> data = dpack::to_binary(in, format);
+  EXPECT_EQ(data.size(), dpack::binary_size(in, format));
+  EXPECT_EQ(dpack::from_binary<Entity>(data, format), in);
+
+  // Numbers can always be borrowed from an aligned buffer
+  std::optional<std::vector<double>> values = std::vector<double>{1.0, 2.0};
+  data = dpack::to_binary(values, format);
+  std::optional<std::span<const double>> view;
+  dpack::BinaryReader reader(data, format);
+  reader.value(view);
+  ASSERT_TRUE(reader.valid());
+  ASSERT_TRUE(view.has_value());
+  EXPECT_TRUE(std::equal(view->begin(), view->end(), values->begin(), values->end()));
+
+  // Padding is relative to the start of the data when streaming
+  std::stringstream stream;
+  std::vector<std::uint8_t> buffer(16);
+  dpack::BinaryWriter stream_writer(stream, buffer, format);
+  stream_writer.value(in);
+  stream_writer.finish();
+  std::string streamed = stream.str();
+  data = dpack::to_binary(in, format);
+  EXPECT_EQ(std::vector<std::uint8_t>(streamed.begin(), streamed.end()), data);
+
+  Entity out;
+  dpack::BinaryReader stream_reader(stream, buffer, format);
+  stream_reader.value(out);
+  EXPECT_TRUE(stream_reader.valid());
+  EXPECT_EQ(out, in);
+}
+
+namespace {
+
+struct FixedClass {
+  Pose pose;
+  std::array<float, 4> values;
+  Physics physics;
+  bool flag;
+  DPACK_CLASS_INLINE(pose, values, physics, flag)
+};
+
+struct VariableClass {
+  Pose pose;
+  std::string name;
+  DPACK_CLASS_INLINE(pose, name)
+};
+
+} // namespace
+
+TEST(Binary, FixedSize) {
+  static_assert(dpack::fixed_binary_size<double> == 8);
+  static_assert(dpack::fixed_binary_size<Physics> == 4);
+  static_assert(dpack::fixed_binary_size<Circle> == 8);
+  static_assert(dpack::fixed_binary_size<Pose> == 24);
+  static_assert(dpack::fixed_binary_size<std::array<Rect, 2>> == 32);
+  static_assert(dpack::fixed_binary_size<FixedClass> == 24 + 16 + 4 + 1);
+  static_assert(!dpack::fixed_size_type<std::string>);
+  static_assert(!dpack::fixed_size_type<std::optional<double>>);
+  static_assert(!dpack::fixed_size_type<std::vector<double>>);
+  static_assert(!dpack::fixed_size_type<VariableClass>);
+  static_assert(!dpack::fixed_size_type<Entity>);
+
+  FixedClass value = {{1, 2, 3}, {4, 5, 6, 7}, Physics::Kinematic, true};
+  std::vector<std::uint8_t> data(100);
+  dpack::to_binary(value, data);
+  EXPECT_EQ(data.size(), dpack::fixed_binary_size<FixedClass>);
+  EXPECT_EQ(dpack::binary_size(value), data.size());
+  // Other formats still measure the value
+  EXPECT_EQ(
+      dpack::binary_size(value, dpack::BinaryFormat::Compact),
+      dpack::to_binary(value, dpack::BinaryFormat::Compact).size());
+
+  auto result = dpack::from_binary<FixedClass>(data);
+  EXPECT_EQ(result.pose.angle, 3);
+  EXPECT_EQ(result.values[3], 7);
+  EXPECT_EQ(result.physics, Physics::Kinematic);
+  EXPECT_TRUE(result.flag);
+}
+
+TEST(Binary, HandWrittenClass) {
+  // Sprite only defines the virtual read/write (DPACK_CLASS_DECL()), which are used instead
+  const Sprite in = Entity::example().sprite;
+  Sprite out = dpack::from_binary<Sprite>(dpack::to_binary(in));
+  EXPECT_EQ(out.width, in.width);
+  ASSERT_EQ(out.data.size(), in.data.size());
+  EXPECT_EQ(out.data[3].g, in.data[3].g);
+}
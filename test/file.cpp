@@ -2,8 +2,12 @@
 
 #include <datapack/examples/entity.hpp>
 #include <datapack/file.hpp>
+#include <datapack/std/optional.hpp>
+#include <datapack/std/span.hpp>
+#include <datapack/std/string_view.hpp>
 #include <datapack/std/vector.hpp>
 #include <filesystem>
+#include <fstream>
 
 TEST(File, WriteRead) {
   dpack::FileWriter writer("entity.dpack");
@@ -37,3 +41,381 @@ TEST(File, WriteRead) {
 
   std::filesystem::remove("entity.dpack");
 }
+
+TEST(File, Json) {
+  const auto schema = dpack::Schema::make<Entity>();
+  const std::string json = dpack::to_json(Entity::example());
+
+  dpack::FileWriter writer("entity.dpack");
+  writer.write_json("entity", json, schema);
+  writer.close();
+
+  dpack::FileReader reader("entity.dpack");
+  ASSERT_EQ(reader.next(), "entity");
+  std::stringstream os;
+  reader.read_json(schema, os);
+  EXPECT_EQ(os.str(), json);
+  EXPECT_FALSE(reader.next());
+  reader.close();
+
+  dpack::FileReader typed_reader("entity.dpack");
+  ASSERT_EQ(typed_reader.next(), "entity");
+  EXPECT_EQ(typed_reader.read<Entity>(), Entity::example());
+  typed_reader.close();
+
+  // Invalid JSON doesn't write anything, so the file stays readable
+  dpack::FileWriter invalid_writer("entity.dpack");
+  EXPECT_THROW(invalid_writer.write_json("entity", "{\"index\": ", schema), dpack::JsonLoadError);
+  EXPECT_THROW(invalid_writer.write_json("entity", "{}", schema), dpack::SchemaError);
+  invalid_writer.write_json("entity", json, schema);
+  invalid_writer.close();
+
+  dpack::FileReader invalid_reader("entity.dpack");
+  ASSERT_EQ(invalid_reader.next(), "entity");
+  EXPECT_EQ(invalid_reader.read<Entity>(), Entity::example());
+  EXPECT_FALSE(invalid_reader.next());
+  invalid_reader.close();
+
+  std::filesystem::remove("entity.dpack");
+}
+
+namespace evolution {
+
+struct PointV1 {
+  int x;
+  int y;
+  DPACK_CLASS_INLINE(x, y)
+};
+
+struct RecordV1 {
+  int id;
+  std::string name;
+  double removed;
+  std::vector<PointV1> points;
+  DPACK_CLASS_INLINE(id, name, removed, points)
+};
+
+struct PointV2 {
+  double y;
+  double x;
+  double z = -1;
+  DPACK_CLASS_INLINE(y, x, z)
+};
+
+struct RecordV2 {
+  std::string name;
+  std::optional<std::int64_t> id;
+  int added = 5;
+  std::vector<PointV2> points;
+  DPACK_CLASS_INLINE(name, id, added, points)
+};
+
+struct Ordered {
+  double a;
+  int b;
+  DPACK_CLASS_INLINE(a, b)
+};
+
+struct Reordered {
+  int b;
+  double a;
+  DPACK_CLASS_INLINE(b, a)
+};
+
+struct AddedV1 {
+  int id;
+  DPACK_CLASS_INLINE(id)
+};
+
+struct AddedV2 {
+  int id;
+  std::string string = "default";
+  bool boolean = true;
+  Physics physics = Physics::Static;
+  std::optional<int> optional = 7;
+  std::vector<int> list = {1, 2};
+  Shape shape = Rect{1, 2};
+  Pose pose = {1, 2, 3};
+  DPACK_CLASS_INLINE(id, string, boolean, physics, optional, list, shape, pose)
+};
+
+} // namespace evolution
+
+TEST(File, SchemaEvolution) {
+  using namespace evolution;
+  const RecordV1 in = {3, "record", 1.5, {{1, 2}, {3, 4}}};
+
+  dpack::FileWriter writer("record.dpack", true);
+  writer.write("record", in);
+  writer.write("record", in);
+  writer.close();
+
+  dpack::FileReader reader("record.dpack");
+  ASSERT_EQ(reader.next(), "record");
+  EXPECT_EQ(reader.read<RecordV1>().points.size(), 2);
+  ASSERT_EQ(reader.next(), "record");
+  RecordV2 out = reader.read<RecordV2>();
+  EXPECT_FALSE(reader.next());
+  reader.close();
+
+  EXPECT_EQ(out.name, "record");
+  EXPECT_EQ(out.id, 3);
+  EXPECT_EQ(out.added, 5);
+  ASSERT_EQ(out.points.size(), 2);
+  EXPECT_EQ(out.points[1].x, 3);
+  EXPECT_EQ(out.points[1].y, 4);
+  EXPECT_EQ(out.points[1].z, -1);
+
+  // Without the schema, the type must match
+  dpack::FileWriter writer_without("record.dpack");
+  writer_without.write("record", in);
+  writer_without.close();
+  dpack::FileReader reader_without("record.dpack");
+  ASSERT_EQ(reader_without.next(), "record");
+  EXPECT_THROW(reader_without.read<RecordV2>(), dpack::FileReader::TypeError);
+  reader_without.close();
+
+  // Reordering members doesn't change the hash, so the schemas themselves are compared
+  ASSERT_EQ(dpack::get_hash<Ordered>(), dpack::get_hash<Reordered>());
+  dpack::FileWriter writer_ordered("record.dpack", true);
+  writer_ordered.write("ordered", Ordered{1.5, 2});
+  writer_ordered.close();
+  dpack::FileReader reader_ordered("record.dpack");
+  ASSERT_EQ(reader_ordered.next(), "ordered");
+  Reordered reordered = reader_ordered.read<Reordered>();
+  EXPECT_EQ(reordered.a, 1.5);
+  EXPECT_EQ(reordered.b, 2);
+  reader_ordered.close();
+  dpack::MappedFileReader mapped_ordered("record.dpack");
+  EXPECT_EQ(mapped_ordered.read<Reordered>("ordered").b, 2);
+  mapped_ordered.close();
+
+  std::filesystem::remove("record.dpack");
+}
+
+TEST(File, SchemaEvolutionAddedMembers) {
+  using namespace evolution;
+  dpack::FileWriter writer("added.dpack", true);
+  writer.write("added", AddedV1{3});
+  writer.close();
+
+  // Added members of any type keep their default value
+  auto check = [](const AddedV2& added) {
+    EXPECT_EQ(added.id, 3);
+    EXPECT_EQ(added.string, "default");
+    EXPECT_TRUE(added.boolean);
+    EXPECT_EQ(added.physics, Physics::Static);
+    EXPECT_EQ(added.optional, 7);
+    EXPECT_EQ(added.list, std::vector<int>({1, 2}));
+    ASSERT_TRUE(std::holds_alternative<Rect>(added.shape));
+    EXPECT_EQ(std::get<Rect>(added.shape).height, 2);
+    EXPECT_EQ(added.pose.angle, 3);
+  };
+
+  dpack::FileReader reader("added.dpack");
+  ASSERT_EQ(reader.next(), "added");
+  check(reader.read<AddedV2>());
+  reader.close();
+
+  dpack::MappedFileReader mapped_reader("added.dpack");
+  check(mapped_reader.read<AddedV2>("added"));
+  mapped_reader.close();
+
+  std::filesystem::remove("added.dpack");
+}
+
+struct Strings {
+  std::string a;
+  std::string b;
+  DPACK_CLASS_INLINE(a, b)
+};
+
+struct StringViews {
+  std::string_view a;
+  std::string_view b;
+  DPACK_CLASS_INLINE(a, b)
+};
+
+TEST(File, Borrowed) {
+  const Strings small = {"a", "b"};
+  const Strings large = {std::string(40000, 'a'), std::string(40000, 'b')};
+  ASSERT_EQ(dpack::get_hash<Strings>(), dpack::get_hash<StringViews>());
+
+  dpack::FileWriter writer("strings.dpack");
+  writer.write("small", small);
+  writer.write("large", large);
+  writer.close();
+
+  // The large value is streamed, so views into it would be overwritten by later reads
+  dpack::FileReader reader("strings.dpack");
+  ASSERT_EQ(reader.next(), "small");
+  StringViews small_views = reader.read<StringViews>();
+  EXPECT_EQ(small_views.a, small.a);
+  EXPECT_EQ(small_views.b, small.b);
+  ASSERT_EQ(reader.next(), "large");
+  EXPECT_THROW(reader.read<StringViews>(), dpack::FileReader::FileError);
+  reader.close();
+
+  dpack::FileReader copy_reader("strings.dpack");
+  copy_reader.next();
+  copy_reader.skip();
+  ASSERT_EQ(copy_reader.next(), "large");
+  Strings large_copy = copy_reader.read<Strings>();
+  EXPECT_EQ(large_copy.a, large.a);
+  EXPECT_EQ(large_copy.b, large.b);
+  copy_reader.close();
+
+  dpack::MappedFileReader mapped_reader("strings.dpack");
+  StringViews large_views = mapped_reader.read<StringViews>("large");
+  EXPECT_EQ(large_views.a, large.a);
+  EXPECT_EQ(large_views.b, large.b);
+  mapped_reader.close();
+
+  std::filesystem::remove("strings.dpack");
+}
+
+TEST(File, ZeroHash) {
+  // The schema of an int hashes to zero, which mustn't be mistaken for anything else
+  ASSERT_EQ(dpack::get_hash<int>(), 0);
+  for (bool embed_schemas : {false, true}) {
+    dpack::FileWriter writer("count.dpack", embed_schemas);
+    writer.write("count", 5);
+    writer.write("count", 6);
+    writer.close();
+
+    dpack::FileReader reader("count.dpack");
+    ASSERT_EQ(reader.next(), "count");
+    EXPECT_EQ(reader.read<int>(), 5);
+    ASSERT_EQ(reader.next(), "count");
+    EXPECT_EQ(reader.read<int>(), 6);
+    EXPECT_FALSE(reader.next());
+    reader.close();
+
+    dpack::MappedFileReader mapped_reader("count.dpack");
+    EXPECT_EQ(mapped_reader.count("count"), 2);
+    EXPECT_EQ(mapped_reader.read<int>("count", 1), 6);
+  }
+  std::filesystem::remove("count.dpack");
+}
+
+TEST(File, Mapped) {
+  using namespace evolution;
+  const RecordV1 record = {3, "record", 1.5, {{1, 2}, {3, 4}}};
+
+  dpack::FileWriter writer("mapped.dpack", true);
+  writer.write("entity", Entity::example());
+  writer.write("list", std::vector<int>{1, 2, 3});
+  writer.write("record", record);
+  writer.write("list", std::vector<int>{4, 5});
+  writer.write<std::string>("string", "hello");
+  writer.close();
+
+  dpack::MappedFileReader reader("mapped.dpack");
+  EXPECT_EQ(
+      reader.labels(),
+      std::vector<std::string>({"entity", "list", "record", "string"}));
+  EXPECT_EQ(reader.count("list"), 2);
+  EXPECT_EQ(reader.count("missing"), 0);
+
+  // Read in any order, and more than once
+  EXPECT_EQ(reader.read<std::vector<int>>("list", 1), std::vector<int>({4, 5}));
+  EXPECT_EQ(reader.read<std::string_view>("string"), "hello");
+  EXPECT_EQ(reader.read<Entity>("entity"), Entity::example());
+  EXPECT_EQ(reader.read<std::vector<int>>("list"), std::vector<int>({1, 2, 3}));
+  EXPECT_EQ(reader.read<std::vector<int>>("list", 1), std::vector<int>({4, 5}));
+
+  RecordV2 evolved = reader.read<RecordV2>("record");
+  EXPECT_EQ(evolved.name, "record");
+  EXPECT_EQ(evolved.id, 3);
+  ASSERT_EQ(evolved.points.size(), 2);
+  EXPECT_EQ(evolved.points[1].x, 3);
+
+  const auto schema = dpack::Schema::make<Entity>();
+  EXPECT_EQ(
+      dpack::from_object<Entity>(reader.read_object("entity", schema)),
+      Entity::example());
+
+  EXPECT_THROW(reader.read<std::string>("list"), dpack::MappedFileReader::TypeError);
+  EXPECT_THROW(reader.read<std::vector<int>>("list", 2), std::out_of_range);
+  EXPECT_THROW(reader.read<std::string>("missing"), std::out_of_range);
+  reader.close();
+  EXPECT_TRUE(reader.labels().empty());
+  EXPECT_THROW(reader.read<std::string_view>("string"), dpack::MappedFileReader::FileError);
+
+  // Truncated file
+  std::filesystem::resize_file("mapped.dpack", std::filesystem::file_size("mapped.dpack") - 1);
+  EXPECT_THROW(dpack::MappedFileReader("mapped.dpack"), dpack::MappedFileReader::FileError);
+
+  std::filesystem::remove("mapped.dpack");
+}
+
+TEST(File, MappedAligned) {
+  // Labels of different lengths leave the chunk data at different offsets before padding
+  const std::vector<std::string> labels = {"a", "ab", "abcd"};
+  const std::vector<double> values = {1.5, 2.5, 3.5};
+
+  dpack::FileWriter writer("aligned.dpack");
+  for (const auto& label : labels) {
+    writer.write(label, values);
+  }
+  writer.close();
+
+  dpack::MappedFileReader reader("aligned.dpack");
+  for (const auto& label : labels) {
+    auto span = reader.read<std::span<const double>>(label);
+    EXPECT_EQ(std::vector<double>(span.begin(), span.end()), values);
+  }
+  reader.close();
+
+  // The streaming reader skips the padding
+  dpack::FileReader file_reader("aligned.dpack");
+  for (const auto& label : labels) {
+    EXPECT_EQ(file_reader.next(), label);
+    EXPECT_EQ(file_reader.read<std::vector<double>>(), values);
+  }
+  EXPECT_EQ(file_reader.next(), std::nullopt);
+  file_reader.close();
+
+  std::filesystem::remove("aligned.dpack");
+}
+
+TEST(File, LegacyLayout) {
+  // Files written before chunk data was aligned have no padding after the chunk header
+  auto write_chunk = [](std::ofstream& os, const std::string& label, const auto& value) {
+    using T = std::decay_t<decltype(value)>;
+    const std::uint32_t label_size = label.size();
+    const std::uint64_t hash = dpack::get_hash<T>();
+    const std::vector<std::uint8_t> data = dpack::to_binary(value);
+    const std::uint64_t data_size = data.size();
+    os.write((const char*)&label_size, sizeof(label_size));
+    os.write(label.data(), label.size());
+    os.write((const char*)&hash, sizeof(hash));
+    os.write((const char*)&data_size, sizeof(data_size));
+    os.write((const char*)data.data(), data.size());
+  };
+  {
+    std::ofstream os("legacy.dpack", std::ios_base::binary);
+    os << "DATAPACK";
+    write_chunk(os, "", std::vector<double>{1.5, 2.5});
+    write_chunk(os, "entity", Entity::example());
+  }
+
+  EXPECT_EQ(
+      dpack::from_file<std::vector<double>>("legacy.dpack"),
+      std::vector<double>({1.5, 2.5}));
+
+  dpack::FileReader reader("legacy.dpack");
+  EXPECT_EQ(reader.next(), "");
+  reader.skip();
+  EXPECT_EQ(reader.next(), "entity");
+  EXPECT_EQ(reader.read<Entity>(), Entity::example());
+  EXPECT_EQ(reader.next(), std::nullopt);
+  reader.close();
+
+  dpack::MappedFileReader mapped_reader("legacy.dpack");
+  EXPECT_EQ(mapped_reader.read<std::vector<double>>(""), std::vector<double>({1.5, 2.5}));
+  EXPECT_EQ(mapped_reader.read<Entity>("entity"), Entity::example());
+  mapped_reader.close();
+
+  std::filesystem::remove("legacy.dpack");
+}
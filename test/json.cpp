@@ -1,6 +1,9 @@
 #include <datapack/examples/entity.hpp>
 #include <datapack/json.hpp>
+#include <datapack/std/span.hpp>
+#include <datapack/std/vector.hpp>
 #include <gtest/gtest.h>
+#include <sstream>
 
 static std::vector<std::string> get_lines(const std::string& text) {
   std::vector<std::string> lines;
@@ -79,3 +82,132 @@ TEST(Format, JsonLoad) {
   expected.sprite.data.clear(); // Ignore data
   ASSERT_EQ(value, expected);
 }
+
+TEST(Format, JsonReaderKeyOrder) {
+  // Keys in a different order, with an unknown key
+  const std::string json = R"({
+    "pose": {"angle": 3, "y": 2, "x": 1},
+    "assigned_items": [1, 2, -1],
+    "unknown": {"a": [1, "]", {}]},
+    "sprite": {"data": "", "height": 2, "width": 2},
+    "name": "player",
+    "hitbox": {"value_circle": {"radius": 1}, "type": "circle"},
+    "enabled": true,
+    "items": [
+        {"name": "hp_potion", "count": 5},
+        {"name": "sword", "count": 1},
+        {"name": "map", "count": 1},
+        {"name": "gold", "count": 120}
+    ],
+    "physics": "kinematic",
+    "index": 5
+  })";
+
+  auto expected = Entity::example();
+  expected.sprite.data.clear();
+
+  Entity value;
+  dpack::JsonReader reader(json);
+  reader.value(value);
+  EXPECT_TRUE(reader.valid());
+  EXPECT_EQ(value, expected);
+
+  // Same result as reading through an Object
+  EXPECT_EQ(dpack::from_object<Entity>(dpack::load_json(json)), value);
+}
+
+struct WithBinary {
+  int a;
+  std::span<const std::uint8_t> b;
+  DPACK_CLASS_INLINE(a, b)
+};
+
+TEST(Format, JsonReaderInvalid) {
+  Pose pose;
+  const std::string missing_key_json = R"({"x": 1, "angle": 3})";
+  dpack::JsonReader missing_key(missing_key_json);
+  missing_key.value(pose);
+  EXPECT_FALSE(missing_key.valid());
+
+  const std::string wrong_type_json = R"({"x": 1, "y": "2", "angle": 3})";
+  dpack::JsonReader wrong_type(wrong_type_json);
+  wrong_type.value(pose);
+  EXPECT_FALSE(wrong_type.valid());
+  EXPECT_EQ(pose.angle, 3);
+
+  WithBinary with_binary;
+  const std::string missing_binary_json = R"({"a": 1})";
+  dpack::JsonReader missing_binary(missing_binary_json);
+  missing_binary.value(with_binary);
+  EXPECT_FALSE(missing_binary.valid());
+  EXPECT_EQ(with_binary.a, 1);
+  EXPECT_TRUE(with_binary.b.empty());
+
+  EXPECT_THROW(dpack::from_json<Pose>(R"({"x": 1, "y": 2, "angle": 3)"), dpack::JsonLoadError);
+}
+
+TEST(Format, JsonWriter) {
+  Entity example = Entity::example();
+
+  // Pretty output matches dumping an Object
+  EXPECT_EQ(dpack::to_json(example), dpack::dump_json(dpack::to_object(example)));
+
+  const std::string compact = dpack::to_json(example, false);
+  EXPECT_EQ(compact.find_first_of(" \n"), std::string::npos);
+  EXPECT_EQ(dpack::from_json<Entity>(compact), example);
+
+  std::stringstream ss;
+  dpack::JsonWriter writer(ss, false);
+  writer.value(example);
+  writer.finish();
+  EXPECT_EQ(ss.str(), compact);
+
+  EXPECT_EQ(dpack::to_json(std::vector<Item>{}), "[]");
+}
+
+TEST(Format, JsonScan) {
+  // Long strings and whitespace runs cover the vectorised scanners, not just the scalar tail
+  const std::string name(100, 'x');
+  const std::string space(100, ' ');
+  const std::string json =
+      "{" + space + "\"name\":" + space + "\"" + name + "\"," + space +
+      "\"values\": [-1.5e3," + space + "42, true, null]}";
+
+  dpack::Object object = dpack::load_json(json);
+  EXPECT_EQ(object["name"].string(), name);
+  EXPECT_EQ(object["values"][0].number(), -1500);
+  EXPECT_EQ(object["values"][1].number(), 42);
+  EXPECT_EQ(object["values"][2].boolean(), true);
+
+  Pose pose;
+  const std::string pose_json = "{\"x\": 1.25," + space + "\"y\": -2, \"angle\": 3e-1}";
+  dpack::JsonReader reader(pose_json);
+  reader.value(pose);
+  EXPECT_TRUE(reader.valid());
+  EXPECT_EQ(pose.x, 1.25);
+  EXPECT_EQ(pose.y, -2);
+  EXPECT_EQ(pose.angle, 0.3);
+
+  // Scalars must parse completely
+  EXPECT_THROW(dpack::load_json(R"({"x": 12abc})"), dpack::JsonLoadError);
+  EXPECT_THROW(dpack::load_json(R"({"x": nul})"), dpack::JsonLoadError);
+}
+
+TEST(Format, JsonBinaryTranscode) {
+  const Entity example = Entity::example();
+  const auto schema = dpack::Schema::make<Entity>();
+  const auto bytes = dpack::to_binary(example);
+
+  const std::string json = dpack::binary_to_json(schema, bytes);
+  EXPECT_EQ(json, dpack::to_json(example));
+  EXPECT_EQ(dpack::json_to_binary(schema, json), bytes);
+
+  std::stringstream is(std::string(bytes.begin(), bytes.end()));
+  std::stringstream os;
+  dpack::binary_to_json(schema, is, os, false);
+  EXPECT_EQ(os.str(), dpack::to_json(example, false));
+
+  std::string invalid_json = json;
+  invalid_json.replace(invalid_json.find("\"name\""), 6, "\"other\"");
+  EXPECT_THROW(dpack::json_to_binary(schema, invalid_json), dpack::SchemaError);
+}
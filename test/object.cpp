@@ -5,6 +5,9 @@
 #include <gtest/gtest.h>
 #include <sstream>
 
+// Large enough that copying the data would be noticeable
+static constexpr std::size_t blob_size = 1 << 20;
+
 TEST(Object, ConstructFromPrimitive) {
   using namespace dpack;
 
@@ -333,6 +336,335 @@ TEST(Object, ObjectEraseRemovesAndDecreasesSize) {
   EXPECT_EQ(object.size(), 2);
 }
 
+TEST(Object, WideMapUsesKeyIndex) {
+  using namespace dpack;
+
+  // Enough keys that the map is indexed, with erasures and re-insertions
+  const std::size_t N = 1000;
+  Object object;
+  for (std::size_t i = 0; i < N; i++) {
+    object.insert("key_" + std::to_string(i), double(i));
+  }
+  EXPECT_EQ(object.size(), N);
+  EXPECT_THROW(object.insert("key_10", 0), Object::KeyError);
+
+  for (std::size_t i = 0; i < N; i += 2) {
+    object["key_" + std::to_string(i)].erase();
+  }
+  EXPECT_EQ(object.size(), N / 2);
+  object["key_0"] = "back";
+  EXPECT_EQ(object.size(), N / 2 + 1);
+
+  for (std::size_t i = 0; i < N; i++) {
+    auto value = object.find("key_" + std::to_string(i));
+    if (i == 0) {
+      ASSERT_TRUE(value && value->string() == "back");
+    } else if (i % 2 == 0) {
+      EXPECT_FALSE(value);
+    } else {
+      ASSERT_TRUE(value && value->number() == i);
+    }
+  }
+
+  // Insertion order is preserved
+  std::size_t expected = 1;
+  for (const auto& [key, value] : object.items()) {
+    if (expected < N) {
+      EXPECT_EQ(key, "key_" + std::to_string(expected));
+      expected += 2;
+    } else {
+      EXPECT_EQ(key, "key_0");
+    }
+  }
+
+  // Iterating a mutable object only reads the keys, so the index is kept
+  EXPECT_TRUE(object::TreeRef(object).tree.map_indexed(0));
+  object.items().begin()->rename("renamed");
+  EXPECT_TRUE(object::TreeRef(object).tree.map_indexed(0));
+  EXPECT_FALSE(object.contains("key_1"));
+  EXPECT_EQ(object.at("renamed").number(), 1);
+  EXPECT_THROW(object.items().begin()->rename("key_3"), Object::KeyError);
+  object.items().begin()->rename("key_1");
+
+  // Assigning to a key, or one of its characters, renames the element in the same way
+  for (auto [key, value] : object.items()) {
+    if (key == "key_5") {
+      key = "assigned";
+    } else if (key == "key_7") {
+      key[0] = 'K';
+    }
+  }
+  EXPECT_TRUE(object::TreeRef(object).tree.map_indexed(0));
+  EXPECT_EQ(object.at("assigned").number(), 5);
+  EXPECT_EQ(object.at("Key_7").number(), 7);
+  EXPECT_FALSE(object.contains("key_7"));
+  EXPECT_THROW(object.items().begin()->key() = "key_3", Object::KeyError);
+  object.find("assigned").key() = "key_5";
+  object.find("Key_7").key()[0] = 'k';
+
+  ConstObject clone = object.clone();
+  EXPECT_EQ(clone, object);
+  EXPECT_EQ(clone.at("key_999").number(), 999);
+  EXPECT_FALSE(clone.contains("key_998"));
+
+  object.to_list();
+  EXPECT_EQ(object.size(), 0);
+  object.to_map();
+  object.insert("key_1", 1);
+  EXPECT_EQ(object.size(), 1);
+  EXPECT_EQ(object.at("key_1").number(), 1);
+}
+
+TEST(Object, LongListUsesIndex) {
+  using namespace dpack;
+
+  const std::size_t N = 1000;
+  Object object;
+  for (std::size_t i = 0; i < N; i++) {
+    object.emplace_back() = double(i);
+  }
+  EXPECT_EQ(object.size(), N);
+  for (std::size_t i = 0; i < N; i++) {
+    ASSERT_EQ(object[i].number(), i);
+  }
+  EXPECT_FALSE(object[N].ptr());
+
+  // Erase from the front, middle and back
+  object[N - 1].erase();
+  object[N / 2].erase();
+  object[0].erase();
+  EXPECT_EQ(object.size(), N - 3);
+  EXPECT_EQ(object[0].number(), 1);
+  EXPECT_EQ(object[N / 2 - 2].number(), N / 2 - 1);
+  EXPECT_EQ(object[N / 2 - 1].number(), N / 2 + 1);
+  EXPECT_EQ(object[N - 4].number(), N - 2);
+
+  object.push_back(-1);
+  EXPECT_EQ(object[N - 3].number(), -1);
+
+  // Erasing from the front drops the index, which is rebuilt on the next access
+  for (std::size_t i = 0; i < 10; i++) {
+    object[0].erase();
+  }
+  EXPECT_FALSE(object::TreeRef(object).tree.list_indexed(0));
+  EXPECT_EQ(object[0].number(), 11);
+  EXPECT_TRUE(object::TreeRef(object).tree.list_indexed(0));
+  EXPECT_EQ(object[N - 13].number(), -1);
+
+  ConstObject clone = object.clone();
+  EXPECT_EQ(clone, object);
+  EXPECT_EQ(clone.size(), N - 12);
+  EXPECT_EQ(clone[N / 2 - 11].number(), N / 2 + 1);
+
+  object.to_list();
+  EXPECT_EQ(object.size(), 0);
+  object.push_back(1);
+  EXPECT_EQ(object[0].number(), 1);
+}
+
+TEST(Object, RenamingKeyDoesNotAffectOthers) {
+  using namespace dpack;
+
+  // Both "a" keys share an interned key, which iterating a mutable object doesn't copy
+  Object object = {{"x", {{"a", 1}}}, {"y", {{"a", 2}}}};
+  for (const auto& [key, value] : object["x"].items()) {
+    EXPECT_EQ(&key.str(), &object["y"].items().begin()->key().str());
+  }
+  for (auto [key, value] : object["x"].items()) {
+    key = "b";
+  }
+  EXPECT_TRUE(object["x"].contains("b"));
+  EXPECT_FALSE(object["x"].contains("a"));
+  EXPECT_EQ(object["y"].at("a").number(), 2);
+
+  // Erased strings are reused without leaking values between nodes
+  object["x"]["b"] = "first";
+  object["x"]["b"].erase();
+  object["x"]["c"] = "second";
+  object["z"] = std::vector<std::uint8_t>{1, 2};
+  EXPECT_EQ(object["x"]["c"].string(), "second");
+  EXPECT_EQ(object["z"].binary(), std::vector<std::uint8_t>({1, 2}));
+  EXPECT_EQ(object.clone(), object);
+}
+
+TEST(Object, BinaryIsMovedIntoTree) {
+  using namespace dpack;
+
+  // The tree takes the vector's buffer rather than copying it
+  Object object;
+  std::vector<std::uint8_t> blob(blob_size, 0xAB);
+  const std::uint8_t* data = blob.data();
+  object["moved"] = std::move(blob);
+  EXPECT_EQ(object["moved"].binary().data(), data);
+
+  std::vector<std::uint8_t> inserted(blob_size, 0xCD);
+  data = inserted.data();
+  object.insert("inserted", std::move(inserted));
+  EXPECT_EQ(object["inserted"].binary().data(), data);
+
+  // Writing from a span copies the data
+  const auto& source = object["moved"].binary();
+  ObjectWriter writer(object["written"]);
+  writer.binary(std::span<const std::uint8_t>(source.data(), source.size()));
+  EXPECT_NE(object["written"].binary().data(), source.data());
+  EXPECT_EQ(object["written"].binary(), object["moved"].binary());
+}
+
+TEST(Object, AssignmentReplacesChildren) {
+  using namespace dpack;
+
+  Object object = {{"x", 1}};
+  object = Object{{"y", 2}};
+  EXPECT_EQ(object, Object({{"y", 2}}));
+  object = Object(5);
+  EXPECT_EQ(object.size(), 0);
+  EXPECT_EQ(object, 5);
+}
+
+TEST(Object, CompactAfterChurn) {
+  using namespace dpack;
+
+  Object object;
+  auto list = object["list"];
+  for (int i = 0; i < 1000; i++) {
+    list.push_back(Object({{"index", i}, {"name", std::to_string(i)}}));
+  }
+  for (int i = 0; i < 100; i++) {
+    object["map"]["key_" + std::to_string(i)] = i;
+  }
+  // Erase every other element, then add more, which reuses the free nodes
+  for (int i = 0; i < 500; i++) {
+    list[i].erase();
+  }
+  for (int i = 1000; i < 1200; i++) {
+    list.push_back(Object({{"index", i}, {"name", std::to_string(i)}}));
+  }
+
+  Object before = object.clone();
+  object.compact();
+  EXPECT_EQ(object, before);
+
+  // Other handles are invalidated, so look up the list again
+  auto compacted = object["list"];
+  ASSERT_EQ(compacted.size(), 700);
+  for (int i = 0; i < 700; i++) {
+    EXPECT_EQ(compacted[i]["index"].number(), i < 500 ? 2 * i + 1 : i + 500);
+    EXPECT_EQ(compacted[i]["name"].string(), std::to_string(int(compacted[i]["index"].number())));
+  }
+  EXPECT_EQ(object["map"].at("key_99").number(), 99);
+
+  EXPECT_THROW(object["map"].compact(), Object::UsageError);
+}
+
+TEST(Object, SnapshotSharesStorage) {
+  using namespace dpack;
+
+  Object object;
+  object["blob"] = std::vector<std::uint8_t>(blob_size, 0xAB);
+  for (int i = 0; i < 1000; i++) {
+    object["list"].push_back(i);
+    object["map"]["key_" + std::to_string(i)] = std::to_string(i);
+  }
+  Object expected = object.clone();
+
+  // Neither taking the snapshot nor modifying other values copies the binary, which is checked
+  // through const objects, since mutable access to the binary copies it
+  const std::uint8_t* blob = ConstObject(object)["blob"].binary().data();
+  Object snapshot = object.clone();
+  snapshot["list"][500] = -1;
+  snapshot["list"].push_back(1000);
+  snapshot["map"]["key_10"] = "modified";
+  snapshot["map"].insert("new_key", true);
+  snapshot["map"]["key_20"].erase();
+  for (auto [key, value] : snapshot["map"].items()) {
+    if (key == "key_30") {
+      key = "renamed";
+    }
+  }
+  EXPECT_EQ(ConstObject(snapshot)["blob"].binary().data(), blob);
+
+  // Modifying the binary copies it
+  snapshot["blob"].binary()[0] = 0;
+  EXPECT_NE(ConstObject(snapshot)["blob"].binary().data(), blob);
+  EXPECT_EQ(ConstObject(object)["blob"].binary().data(), blob);
+
+  EXPECT_EQ(object, expected);
+  EXPECT_EQ(snapshot["list"][500].number(), -1);
+  EXPECT_EQ(snapshot["list"].size(), 1001);
+  EXPECT_EQ(snapshot["map"]["key_10"].string(), "modified");
+  EXPECT_TRUE(snapshot["map"].contains("new_key"));
+  EXPECT_FALSE(snapshot["map"].contains("key_20"));
+  EXPECT_TRUE(snapshot["map"].contains("renamed"));
+  EXPECT_EQ(snapshot["blob"].binary()[0], 0);
+  EXPECT_EQ(ConstObject(object)["blob"].binary()[0], 0xAB);
+
+  // Modifying the original doesn't affect the snapshot
+  object["list"][0] = 12;
+  EXPECT_EQ(snapshot["list"][0].number(), 0);
+
+  // Merging shares storage with the base
+  Object diff;
+  diff["map"]["key_40"] = "merged";
+  blob = ConstObject(object)["blob"].binary().data();
+  Object merged = object_merge(object, diff);
+  EXPECT_EQ(ConstObject(merged)["blob"].binary().data(), blob);
+  EXPECT_EQ(merged["map"]["key_40"].string(), "merged");
+  EXPECT_EQ(object["map"]["key_40"].string(), "40");
+}
+
+TEST(Object, SnapshotIsolatesReferences) {
+  using namespace dpack;
+
+  // References taken before a snapshot can't modify it
+  Object object = {{"x", "hello"}, {"y", 1}, {"z", std::vector<std::uint8_t>{1, 2}}};
+  auto& string = object["x"].string();
+  auto& number = object["y"].number();
+  auto& binary = object["z"].binary();
+  Object snapshot = object.clone();
+  string = "bye";
+  number = 2;
+  binary[0] = 3;
+  EXPECT_EQ(snapshot["x"].string(), "hello");
+  EXPECT_EQ(snapshot["y"].number(), 1);
+  EXPECT_EQ(snapshot["z"].binary()[0], 1);
+  EXPECT_EQ(object["x"].string(), "bye");
+  EXPECT_EQ(object["y"].number(), 2);
+  EXPECT_EQ(object["z"].binary()[0], 3);
+
+  // Including snapshots taken later
+  Object second = object.clone();
+  string = "again";
+  EXPECT_EQ(second["x"].string(), "bye");
+  EXPECT_EQ(snapshot["x"].string(), "hello");
+}
+
+TEST(Object, SnapshotSharesStorageAfterReferences) {
+  using namespace dpack;
+
+  Object object;
+  object["blob"] = std::vector<std::uint8_t>(blob_size, 0xAB);
+  object["count"] = 0;
+  for (int i = 0; i < 1000; i++) {
+    object["map"]["key_" + std::to_string(i)] = std::to_string(i);
+  }
+
+  // Modifying values in place pins their pages only until the next structural change, after
+  // which a snapshot shares them again
+  object["blob"].binary()[0] = 0xCD;
+  object["count"].number()++;
+  object["map"]["key_10"].string() += "!";
+  object["list"] = {1, 2, 3};
+
+  Object snapshot = object.clone();
+  const ConstObject const_object = object;
+  const ConstObject const_snapshot = snapshot;
+  EXPECT_EQ(const_snapshot["blob"].binary().data(), const_object["blob"].binary().data());
+  EXPECT_EQ(&const_snapshot["count"].number(), &const_object["count"].number());
+  EXPECT_EQ(&const_snapshot["map"]["key_10"].string(), &const_object["map"]["key_10"].string());
+  EXPECT_EQ(const_snapshot["map"]["key_10"].string(), "10!");
+  EXPECT_EQ(const_snapshot["count"].number(), 1);
+}
+
 TEST(Object, ObjectCanIterateOverListValues) {
   using namespace dpack;
 
@@ -673,6 +1005,25 @@ TEST(Object, ObjectMerge) {
   EXPECT_EQ(object_diff(base, merged), diff);
 }
 
+TEST(Object, ObjectMergePrunes) {
+  using namespace dpack;
+
+  // Unlike object_merge_into(), the whole result is pruned, not just the merged paths
+  Object base;
+  base["a"] = 12;
+  base["empty"].to_map();
+  base["null"];
+
+  Object diff;
+  diff["b"] = 24;
+
+  Object expected;
+  expected["a"] = 12;
+  expected["b"] = 24;
+
+  EXPECT_EQ(object_merge(base, diff), expected);
+}
+
 TEST(Object, ObjectDiff) {
   using namespace dpack;
 
@@ -709,6 +1060,172 @@ TEST(Object, ObjectDiffUsageError) {
   EXPECT_THROW(object_diff(base, modified), Object::UsageError);
 }
 
+TEST(Object, ObjectHashes) {
+  using namespace dpack;
+
+  Object a;
+  a["x"] = {{"foo", 1}, {"bar", "two"}};
+  a["y"] = {1.0, 2.0, 0.0};
+  Object b = a.clone();
+  b["y"][2] = -0.0;
+
+  object::ObjectHashes a_hashes(a);
+  object::ObjectHashes b_hashes(b);
+  EXPECT_EQ(a_hashes(a), b_hashes(b));
+  EXPECT_EQ(a_hashes(a["x"]), b_hashes(b["x"]));
+  EXPECT_NE(a_hashes(a["x"]), a_hashes(a["y"]));
+  EXPECT_THROW(a_hashes(b), Object::UsageError);
+
+  // Changing a value, a key or the order of elements changes the hash
+  Object c = a.clone();
+  c["x"]["bar"] = "three";
+  EXPECT_NE(object::ObjectHashes(c)(c), a_hashes(a));
+  c = a;
+  c["x"].items().begin()->key() = "baz";
+  EXPECT_NE(object::ObjectHashes(c)(c), a_hashes(a));
+  c = a;
+  c["y"][0] = 2.0;
+  c["y"][1] = 1.0;
+  EXPECT_NE(object::ObjectHashes(c)(c), a_hashes(a));
+}
+
+TEST(Object, ObjectDiffWideMap) {
+  using namespace dpack;
+
+  Object base;
+  for (int i = 0; i < 10000; i++) {
+    base["map"]["key_" + std::to_string(i)]["value"] = i;
+  }
+  Object modified = base.clone();
+  modified["map"]["key_1234"]["value"] = -1;
+  modified["map"]["key_5678"]["extra"] = true;
+
+  Object expected;
+  expected["map"]["key_1234"]["value"] = -1;
+  expected["map"]["key_5678"]["extra"] = true;
+
+  Object diff = object_diff(base, modified);
+  EXPECT_EQ(diff, expected);
+  EXPECT_EQ(object_merge(base, diff), modified);
+}
+
+TEST(Object, ObjectMergeInto) {
+  using namespace dpack;
+
+  Object base;
+  base["a"] = 12;
+  base["b"]["foo"] = 1;
+  base["b"]["bar"] = 2;
+  auto b = base["b"];
+
+  Object diff;
+  diff["b"]["bar"] = 3;
+  diff["c"] = true;
+
+  Object expected;
+  expected["a"] = 12;
+  expected["b"]["foo"] = 1;
+  expected["b"]["bar"] = 3;
+  expected["c"] = true;
+
+  object_merge_into(base, diff);
+  EXPECT_EQ(base, expected);
+
+  // Unchanged nodes are modified in place, so handles to them stay valid (the tree is too small
+  // to need compacting)
+  EXPECT_EQ(b["bar"].number(), 3);
+
+  // Only the merged paths are pruned: nulls in the diff erase values, along with any maps left
+  // empty, but existing empty maps and nulls elsewhere in base are kept
+  base["empty"].to_map();
+  base["null"];
+  base["d"]["e"]["f"] = 1;
+  Object erase;
+  erase["b"]["foo"].to_null();
+  erase["d"]["e"]["f"].to_null();
+  erase["g"]["h"].to_null();
+  object_merge_into(base, erase);
+  EXPECT_EQ(base["b"], Object({{"bar", 3}}));
+  EXPECT_FALSE(base.contains("d"));
+  EXPECT_FALSE(base.contains("g"));
+  EXPECT_TRUE(base.contains("empty"));
+  EXPECT_TRUE(base.contains("null"));
+}
+
+TEST(Object, ObjectMergeIntoStaysBounded) {
+  using namespace dpack;
+
+  // Each merge replaces the previous values, under new keys, so without compaction both the
+  // free nodes and the unused keys would grow without limit
+  const int N = 200;
+  Object base;
+  for (int i = 0; i < 100; i++) {
+    Object diff;
+    for (int j = 0; j < N; j++) {
+      if (i > 0) {
+        diff["values"]["key_" + std::to_string(i - 1) + "_" + std::to_string(j)].to_null();
+      }
+      diff["values"]["key_" + std::to_string(i) + "_" + std::to_string(j)] = {{"x", j}};
+    }
+    object_merge_into(base, diff);
+
+    ASSERT_EQ(base["values"].size(), N);
+    const object::Tree& tree = object::TreeRef(base).tree;
+    EXPECT_LE(tree.capacity(), std::max(4 * tree.size(), object::Tree::compact_min_nodes));
+    EXPECT_LE(tree.key_capacity(), std::max(4 * tree.size(), object::Tree::compact_min_nodes));
+  }
+  EXPECT_EQ(base["values"]["key_99_10"]["x"].number(), 10);
+
+  // Erasing alone also releases the keys
+  for (int j = 0; j < N; j++) {
+    base["values"]["key_99_" + std::to_string(j)].erase();
+  }
+  for (int j = 0; j < 2000; j++) {
+    base["other"]["key_" + std::to_string(j)] = j;
+    base["other"]["key_" + std::to_string(j)].erase();
+  }
+  EXPECT_LE(object::TreeRef(base).tree.key_capacity(), object::Tree::compact_min_nodes);
+}
+
+TEST(Object, ParallelMatchesSerial) {
+  using namespace dpack;
+
+  Object base;
+  for (int i = 0; i < 500; i++) {
+    auto element = base["key_" + std::to_string(i % 50)]["key_" + std::to_string(i)];
+    element["index"] = i;
+    element["name"] = std::to_string(i);
+    element["values"] = {i, i + 1, i + 2};
+  }
+  Object modified = base.clone();
+  modified["key_3"]["key_53"]["index"] = -1;
+  modified["key_7"]["key_107"]["values"][1] = -1;
+  modified["key_9"]["key_new"] = true;
+  modified["key_new"]["key_new"] = "new";
+
+  Object unpruned = modified.clone();
+  unpruned["key_1"]["key_1"]["null"];
+  unpruned["key_2"]["empty"].to_map();
+  unpruned["key_4"]["key_4"].to_null();
+  unpruned["empty"]["empty"].to_map();
+
+  Object diff = object_diff(base, modified);
+  Object pruned = unpruned.clone();
+  object_prune(pruned);
+  EXPECT_FALSE(pruned == unpruned);
+
+  for (std::size_t threads : {2, 4, 0}) {
+    EXPECT_TRUE(object_equal(base, base.clone(), threads));
+    EXPECT_FALSE(object_equal(base, modified, threads));
+    EXPECT_EQ(object_diff(base, modified, threads), diff);
+    EXPECT_EQ(object_merge(base, diff, threads), modified);
+
+    Object parallel_pruned = unpruned.clone();
+    object_prune(parallel_pruned, threads);
+    EXPECT_EQ(parallel_pruned, pruned);
+  }
+}
+
 TEST(Object, Reader) {
   using namespace dpack;
 
@@ -3,10 +3,12 @@
 #include <datapack/json.hpp>
 #include <datapack/random.hpp>
 #include <datapack/schema/schema.hpp>
+#include <datapack/std/optional.hpp>
 #include <datapack/std/string.hpp>
 #include <datapack/std/variant.hpp>
 #include <datapack/std/vector.hpp>
 #include <gtest/gtest.h>
+#include <thread>
 
 TEST(Schema, Iterator) {
   using namespace dpack;
@@ -59,6 +61,28 @@ TEST(Schema, Iterator) {
     }
     EXPECT_EQ(first_child.skip(), last.next());
   }
+  {
+    // clang-format off
+    Schema schema = Schema::from_tokens({
+      token::List(),
+        token::Optional(),
+          token::VariantBegin({"a", "b"}),
+            token::VariantNext(0),
+              token::Optional(),
+                token::String(),
+            token::VariantNext(1),
+              token::Boolean(),
+          token::VariantEnd()
+    });
+    // clang-format on
+    EXPECT_EQ(schema.begin().skip(), schema.end());
+    EXPECT_EQ(schema.begin().next().skip(), schema.end());
+
+    auto first_body = schema.begin().next().next().next().next();
+    EXPECT_TRUE(first_body.optional());
+    EXPECT_TRUE(first_body.skip().variant_next());
+    EXPECT_EQ(schema.end().skip(), schema.end());
+  }
 }
 
 TEST(Schema, SchemaMake) {
@@ -184,3 +208,82 @@ TEST(Schema, SchemaWithHints) {
 
   EXPECT_EQ(iter, schema.end());
 }
+
+using InnerVariant = std::variant<bool, std::string>;
+using OuterVariant = std::variant<int, InnerVariant>;
+
+namespace dpack {
+DPACK_LABELLED_VARIANT(InnerVariant, 2);
+DPACK_LABELLED_VARIANT_DEF(InnerVariant) = {"boolean", "string"};
+DPACK_LABELLED_VARIANT(OuterVariant, 2);
+DPACK_LABELLED_VARIANT_DEF(OuterVariant) = {"number", "inner"};
+} // namespace dpack
+
+struct ApplyEdgeCases {
+  std::optional<double> absent;
+  std::vector<std::string> empty;
+  std::vector<float> numbers;
+  std::vector<std::vector<int>> nested;
+  WithLimit with_limit;
+  OuterVariant nested_variant;
+  DPACK_CLASS_INLINE(absent, empty, numbers, nested, with_limit, nested_variant)
+};
+
+TEST(Schema, SchemaApplyEdgeCases) {
+  ApplyEdgeCases value;
+  value.numbers = {1.f, 2.f, 3.f};
+  value.nested = {{}, {1, 2}, {3}};
+  value.with_limit.number = 0.5;
+  value.nested_variant = InnerVariant("inner");
+
+  auto schema = dpack::Schema::make<ApplyEdgeCases>();
+  auto bytes = dpack::to_binary(value);
+
+  dpack::Object object;
+  schema.apply(dpack::BinaryReader(bytes), dpack::ObjectWriter(object));
+  EXPECT_EQ(dpack::to_json(value), dpack::dump_json(object));
+
+  // The compiled program is read along with the schema
+  auto schema_read = dpack::from_binary<dpack::Schema>(dpack::to_binary(schema));
+  std::vector<std::uint8_t> bytes_out;
+  dpack::BinaryReader reader(bytes);
+  dpack::BinaryWriter writer(bytes_out);
+  schema_read.apply(reader, writer);
+  writer.finish();
+  EXPECT_EQ(bytes, bytes_out);
+}
+
+TEST(Schema, SchemaApplyInvalid) {
+  // clang-format off
+  auto schema = dpack::Schema::from_tokens({
+    dpack::token::ObjectBegin(),
+      dpack::token::ObjectNext("x"),
+        dpack::token::Number::F64()
+  });
+  // clang-format on
+  dpack::Object object;
+  std::vector<std::uint8_t> bytes(8, 0);
+  EXPECT_THROW(
+      schema.apply(dpack::BinaryReader(bytes), dpack::ObjectWriter(object)),
+      dpack::SchemaError);
+}
+
+TEST(Schema, GetHashThreads) {
+  // Every thread sees the same schema, however the first calls interleave
+  std::vector<std::uint64_t> hashes(8);
+  std::vector<const dpack::Schema*> schemas(hashes.size());
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < hashes.size(); i++) {
+    threads.emplace_back([&, i]() {
+      hashes[i] = dpack::get_hash<Entity>();
+      schemas[i] = &dpack::get_schema<Entity>();
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (std::size_t i = 0; i < hashes.size(); i++) {
+    EXPECT_EQ(hashes[i], dpack::Schema::make<Entity>().hash());
+    EXPECT_EQ(schemas[i], schemas[0]);
+  }
+}